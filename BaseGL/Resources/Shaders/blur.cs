@@ -0,0 +1,71 @@
+#version 450 core
+// Separable depth- and normal-aware blur. Each workgroup filters a line of TILE pixels along
+// the blur direction, caching it in shared memory together with an apron of radius pixels on each side.
+#define TILE 128
+#define MAX_RADIUS 16
+layout (local_size_x = TILE) in;
+
+uniform sampler2D tex;
+uniform sampler2D gDepth; // depth buffer values, at the resolution of tex
+uniform sampler2D gNormal;
+layout (binding = 0, rgba8) uniform writeonly image2D outImage;
+
+uniform ivec2 direction; // (1, 0) for the horizontal pass, (0, 1) for the vertical one
+uniform ivec2 offset; // first pixel of the filtered rectangle
+uniform int radius; // at most MAX_RADIUS
+uniform float spatialSigma; // in pixels
+uniform float depthSigma; // relative to the view depth
+uniform float normalPower;
+uniform mat4 projectionMat;
+
+shared vec3 sColor[TILE + 2 * MAX_RADIUS];
+shared float sDepth[TILE + 2 * MAX_RADIUS];
+shared vec3 sNormal[TILE + 2 * MAX_RADIUS];
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main() {
+    ivec2 size = textureSize(tex, 0);
+    ivec2 across = ivec2(1) - direction;
+    ivec2 origin = offset + direction * int(gl_WorkGroupID.x) * TILE + across * int(gl_WorkGroupID.y);
+
+    for (int i = int(gl_LocalInvocationID.x); i < TILE + 2 * radius; i += TILE) {
+        ivec2 texel = clamp(origin + direction * (i - radius), ivec2(0), size - 1);
+        float depth = texelFetch(gDepth, texel, 0).r;
+        sColor[i] = texelFetch(tex, texel, 0).rgb;
+        sDepth[i] = depth == 1 ? -1.0 : projectionMat[3][2] / (depth * 2.0 - 1.0 + projectionMat[2][2]); // -1: background
+        sNormal[i] = octDecode(texelFetch(gNormal, texel, 0).rg);
+    }
+    barrier();
+
+    ivec2 texel = origin + direction * int(gl_LocalInvocationID.x);
+    if (any(greaterThanEqual(texel, size)))
+        return;
+    int center = int(gl_LocalInvocationID.x) + radius;
+    float depth = sDepth[center];
+    vec3 normal = sNormal[center];
+    if (depth < 0.0) { // background, only the skybox is displayed there
+        imageStore(outImage, texel, vec4(sColor[center], 1.0));
+        return;
+    }
+
+    vec3 acc = vec3(0.0);
+    float total = 0.0;
+    for (int k = -radius; k <= radius; ++k) {
+        int i = center + k;
+        if (sDepth[i] < 0.0)
+            continue;
+        float dz = (sDepth[i] - depth) / (depthSigma * depth);
+        float w = exp(-0.5 * float(k * k) / (spatialSigma * spatialSigma) - dz * dz)
+                * pow(max(dot(normal, sNormal[i]), 0.0), normalPower);
+        acc += w * sColor[i];
+        total += w;
+    }
+    imageStore(outImage, texel, vec4(total > 0.0 ? acc / total : sColor[center], 1.0));
+}
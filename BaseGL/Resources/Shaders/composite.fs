@@ -0,0 +1,82 @@
+#version 450 core
+// Final image, or one of the debug views. The program is compiled once per view mode (MODE, the number keys),
+// so that each variant only holds the lookups it displays, and the passes producing the other targets are culled.
+// The sky is looked up inline in the direction of the pixel, rather than rendered into a target of its own.
+#ifndef MODE
+#define MODE 8
+#endif
+out vec3 FragColor;
+in vec2 TexCoords;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform sampler2D ssdo;
+uniform sampler2D ssdoBlur;
+uniform sampler2D texLighting;
+uniform sampler2D texIndirectLight;
+uniform sampler2D texIndirectLightBlur;
+uniform samplerCube skybox;
+uniform sampler2D ssdoSamples; // fraction of the SSDO kernel evaluated per pixel
+
+uniform mat4 projectionMat;
+uniform mat4 iViewProjectionMat; // clip to world-space directions (view rotation only)
+
+// Distance to the camera plane of a depth buffer value (perspective projection)
+float linearDepth(float depth) {
+    return projectionMat[3][2] / (depth * 2.0 - 1.0 + projectionMat[2][2]);
+}
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// Blue (few samples) to green to red (the whole kernel)
+vec3 heatMap(float t) {
+    return clamp(vec3(2.0 * t - 1.0, 1.0 - abs(2.0 * t - 1.0), 1.0 - 2.0 * t), 0.0, 1.0);
+}
+
+vec3 sky() {
+    vec4 direction = iViewProjectionMat * vec4(TexCoords * 2.0 - 1.0, 1.0, 1.0);
+    return texture(skybox, direction.xyz / direction.w).rgb;
+}
+
+void main()
+{
+#if MODE == 0
+    FragColor = octDecode(texture(gNormal, TexCoords).rg);
+#elif MODE == 7
+    FragColor = sky();
+#else
+    float depth = texture(gDepth, TexCoords).r;
+#if MODE == 8
+    FragColor = depth != 1
+        ? texture(texLighting, TexCoords).rgb + texture(ssdoBlur, TexCoords).rgb + texture(texIndirectLightBlur, TexCoords).rgb
+        : sky();
+#elif MODE == 6
+    FragColor = vec3(depth != 1 ? (linearDepth(depth) - 1) / 10 : 0);
+#else
+    // lighting and SSDO only run where geometry was drawn
+    if (depth == 1) {
+        FragColor = vec3(0);
+        return;
+    }
+#if MODE == 1
+    FragColor = texture(texLighting, TexCoords).rgb;
+#elif MODE == 2
+    FragColor = texture(ssdo, TexCoords).rgb;
+#elif MODE == 3
+    FragColor = texture(ssdoBlur, TexCoords).rgb;
+#elif MODE == 4
+    FragColor = texture(texIndirectLight, TexCoords).rgb;
+#elif MODE == 5
+    FragColor = texture(texIndirectLightBlur, TexCoords).rgb;
+#else
+    FragColor = heatMap(texture(ssdoSamples, TexCoords).r);
+#endif
+#endif
+#endif
+}
@@ -0,0 +1,19 @@
+#version 450 core
+// Splits the G-buffer into 16 quarter-resolution layers: layer i + 4 * j holds the pixels (4x + i, 4y + j),
+// i.e., the pixels sharing the same rotation of the 4x4 interleaved noise tile.
+layout (local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+layout (binding = 0, r32f) uniform writeonly image2DArray depthLayers;
+layout (binding = 1, rg16) uniform writeonly image2DArray normalLayers;
+
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = textureSize(gDepth, 0);
+    if (any(greaterThanEqual(texel, size)))
+        return;
+    ivec3 layerTexel = ivec3(texel / 4, (texel.x & 3) + 4 * (texel.y & 3));
+    imageStore(depthLayers, layerTexel, vec4(texelFetch(gDepth, texel, 0).r));
+    imageStore(normalLayers, layerTexel, vec4(texelFetch(gNormal, texel, 0).rg, 0.0, 0.0));
+}
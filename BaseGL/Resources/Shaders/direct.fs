@@ -2,26 +2,81 @@
 out vec3 FragColor;
 in vec2 TexCoords;
 
-uniform sampler2D gPositionDepth;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
-uniform sampler2D texNoise;
+uniform sampler2D texNoise; // blue noise: rotation of the kernel (R)
 
 uniform vec3 samples[64];
 int kernelSize = 64;
-float radius = 1.0;
+uniform float radius = 1.0;
+// Samples drawn with a cosine-weighted density: the cosine factor of the sky light cancels with it,
+// leaving the ratio 1/2 of the uniform density to the cosine-weighted one
+uniform bool cosineKernel = false;
+// Offset of the rotations, stepped by the golden ratio each frame of the temporal mode
+uniform float noiseOffset = 0.0;
 
 // tile noise texture over screen based on screen dimensions divided by noise size
 uniform samplerCube skybox;
 
 uniform mat4 projectionMat;
+uniform mat4 iProjectionMat; // clip to view-space
 uniform mat4 iViewMat; // view to world-space
 
+// Sky seen by an unoccluded sample: the raw cube map, a lookup in the prefiltered environment over the cone
+// of directions covered by one sample of the kernel, or the spherical harmonics projection of the environment
+#define SKY_RAW 0
+#define SKY_CONE 1
+#define SKY_SH 2
+uniform int skyLookup = SKY_RAW;
+uniform vec3 shRadiance[9];
+
+vec3 skyRadiance(vec3 direction, float kernelSize) {
+    if (skyLookup == SKY_SH) {
+        vec3 d = normalize(direction);
+        vec3 c = shRadiance[0] * 0.282095
+               + (shRadiance[1] * d.y + shRadiance[2] * d.z + shRadiance[3] * d.x) * 0.488603
+               + (shRadiance[4] * d.x * d.y + shRadiance[5] * d.y * d.z + shRadiance[7] * d.x * d.z) * 1.092548
+               + shRadiance[6] * 0.315392 * (3.0 * d.z * d.z - 1.0)
+               + shRadiance[8] * 0.546274 * (d.x * d.x - d.y * d.y);
+        return max(c, vec3(0.0));
+    }
+    if (skyLookup == SKY_CONE) {
+        // level whose texels cover the solid angle of a sample, 4 pi / (6 size^2) = 2 pi / kernelSize
+        float level = log2(float(textureSize(skybox, 0).x) * sqrt(3.0 / kernelSize));
+        return textureLod(skybox, direction, level).rgb;
+    }
+    return textureLod(skybox, direction, 0.0).rgb;
+}
+
+vec3 viewPosition(vec2 uv) {
+    vec4 clip = vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    vec4 view = iProjectionMat * clip;
+    return view.xyz / view.w;
+}
+
+// View-space z of a depth buffer value (perspective projection)
+float viewDepth(float depth) {
+    return -projectionMat[3][2] / (depth * 2.0 - 1.0 + projectionMat[2][2]);
+}
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main() {
+    if (texture(gDepth, TexCoords).r == 1) // background: nothing to shade, the target keeps its clear value
+        discard;
     vec2 noiseScale = textureSize(gNormal,0) / textureSize(texNoise,0);
     // get input for SSDO algorithm
-    vec3 fragPos = texture(gPositionDepth, TexCoords).xyz;
-    vec3 normal = normalize(texture(gNormal, TexCoords).rgb);
-    vec3 randomVec = normalize(texture(texNoise, TexCoords * noiseScale).xyz);
+    vec3 fragPos = viewPosition(TexCoords);
+    vec3 normal = octDecode(texture(gNormal, TexCoords).rg);
+    vec2 noise = texture(texNoise, TexCoords * noiseScale).rg;
+    float angle = 6.2831853 * fract(noise.r + noiseOffset);
+    vec3 randomVec = vec3(cos(angle), sin(angle), 0.0);
     // create TBN change-of-basis matrix: from tangent-space to view-space
     vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
     vec3 bitangent = cross(normal, tangent);
@@ -41,14 +96,14 @@ void main() {
         offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
 
         // get sample depth
-        float sampleDepth = texture(gPositionDepth, offset.xy).z; // get depth value of kernel sample
-        float depth2 = texture(gPositionDepth, offset.xy).a; // has it been drawn to ?
+        float depth = texture(gDepth, offset.xy).r;
+        float sampleDepth = viewDepth(depth); // get depth value of kernel sample
 
         // range check & accumulate
-		if (sampleDepth < samplePos.z || depth2 == 1) {
+		if (sampleDepth < samplePos.z || depth == 1) { // behind the surface, or nothing drawn
 			vec4 skyboxDirection = iViewMat * vec4(samplePos - fragPos, 0.0);
-			vec3 skyboxColor = texture(skybox, skyboxDirection.xyz).xyz;
-			directLight += skyboxColor * dot(normal, normalize(samplePos - fragPos));
+			vec3 skyboxColor = skyRadiance(skyboxDirection.xyz, kernelSize);
+			directLight += skyboxColor * (cosineKernel ? 0.5 : dot(normal, normalize(samplePos - fragPos)));
 		}
     }
 
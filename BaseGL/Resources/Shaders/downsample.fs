@@ -0,0 +1,33 @@
+#version 450 core
+layout (location = 0) out float lowDepth;
+layout (location = 1) out vec2 lowNormal;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+
+uniform int factor; // 2 for half resolution, 4 for quarter
+
+// Each low resolution pixel keeps one full resolution sample of its block, so that depths and normals
+// are never averaged across silhouettes. Alternating the nearest and the farthest sample in a checkerboard
+// keeps both sides of the depth discontinuities represented.
+void main() {
+    ivec2 lowPixel = ivec2(gl_FragCoord.xy);
+    ivec2 base = lowPixel * factor;
+    ivec2 maxTexel = textureSize(gDepth, 0) - 1;
+    bool keepNearest = ((lowPixel.x + lowPixel.y) & 1) == 0;
+
+    ivec2 bestTexel = base;
+    float best = keepNearest ? 2.0 : -1.0;
+    for (int y = 0; y < factor; ++y) {
+        for (int x = 0; x < factor; ++x) {
+            ivec2 texel = min(base + ivec2(x, y), maxTexel);
+            float depth = texelFetch(gDepth, texel, 0).r;
+            if (keepNearest ? depth < best : depth > best) {
+                best = depth;
+                bestTexel = texel;
+            }
+        }
+    }
+    lowDepth = best;
+    lowNormal = texelFetch(gNormal, bestTexel, 0).rg;
+}
@@ -1,22 +1,21 @@
 #version 450 core
-layout (location = 0) out vec4 gPositionDepth;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec3 gAlbedo;
+layout (location = 0) out vec2 gNormal;
 
-in vec2 TexCoords;
-in vec3 FragPos;
 in vec3 Normal;
 
-uniform float NEAR;
-uniform float FAR;
-float LinearizeDepth(float depth) {
-    float z = depth * 2.0 - 1.0; // Back to NDC
-    return (2.0 * NEAR * FAR) / (FAR + NEAR - z * (FAR - NEAR));
-} // https://learnopengl.com/Advanced-OpenGL/Depth-testing
+// Positions are not stored: readers reconstruct them from the depth buffer
+
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Octahedral normal encoding, remapped to [0,1] for an unsigned normalized target
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return e * 0.5 + 0.5;
+} // http://jcgt.org/published/0003/02/01/
 
 void main() {
-    gPositionDepth.xyz = FragPos;
-    gPositionDepth.w = LinearizeDepth(gl_FragCoord.z);
-    gNormal = normalize(Normal);
-    gAlbedo = vec3(0.95);
+    gNormal = octEncode(normalize(Normal));
 }
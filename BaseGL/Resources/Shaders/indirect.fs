@@ -2,23 +2,44 @@
 out vec3 FragColor;
 in vec2 TexCoords;
 
-uniform sampler2D gPositionDepth;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
-uniform sampler2D texNoise;
+uniform sampler2D texNoise; // blue noise: rotation of the kernel (R)
 uniform sampler2D texLighting;
 
 uniform vec3 samples[64];
 int kernelSize = 64;
-float radius = 1.0;
+uniform float radius = 1.0;
+// Offset of the rotations, stepped by the golden ratio each frame of the temporal mode
+uniform float noiseOffset = 0.0;
 
 uniform mat4 projectionMat;
+uniform mat4 iProjectionMat; // clip to view-space
+
+vec3 viewPosition(vec2 uv) {
+    vec4 clip = vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    vec4 view = iProjectionMat * clip;
+    return view.xyz / view.w;
+}
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
 
 void main() {
+    if (texture(gDepth, TexCoords).r == 1) // background: nothing to shade, the target keeps its clear value
+        discard;
     vec2 noiseScale = textureSize(gNormal,0) / textureSize(texNoise,0);
     // get input for SSDO algorithm
-    vec3 fragPos = texture(gPositionDepth, TexCoords).xyz;
-    vec3 normal = normalize(texture(gNormal, TexCoords).rgb);
-    vec3 randomVec = normalize(texture(texNoise, TexCoords * noiseScale).xyz);
+    vec3 fragPos = viewPosition(TexCoords);
+    vec3 normal = octDecode(texture(gNormal, TexCoords).rg);
+    vec2 noise = texture(texNoise, TexCoords * noiseScale).rg;
+    float angle = 6.2831853 * fract(noise.r + noiseOffset);
+    vec3 randomVec = vec3(cos(angle), sin(angle), 0.0);
     // create TBN change-of-basis matrix: from tangent-space to view-space
     vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
     vec3 bitangent = cross(normal, tangent);
@@ -39,8 +60,8 @@ void main() {
 
         // get sample depth
         float threshold = samplePos.z;
-	    samplePos = texture(gPositionDepth, offset.xy).xyz;
-		vec3 sampleNormal = normalize(texture(gNormal, offset.xy).xyz);
+	    samplePos = viewPosition(offset.xy);
+		vec3 sampleNormal = octDecode(texture(gNormal, offset.xy).rg);
 		vec3 sampleColor = texture(texLighting, offset.xy).rgb;
 
         // range check & accumulate
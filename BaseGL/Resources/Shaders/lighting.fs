@@ -2,9 +2,10 @@
 out vec3 FragColor;
 in vec2 TexCoords;
 
-uniform sampler2D gPositionDepth;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
-uniform sampler2D gAlbedo;
+
+uniform mat4 iProjectionMat; // clip to view-space
 
 struct Light {
     vec3 Position;
@@ -16,11 +17,27 @@ struct Light {
 };
 uniform Light light;
 
+const vec3 Diffuse = vec3(0.95); // uniform material, so not stored in the G-buffer
+
+vec3 viewPosition(vec2 uv) {
+    vec4 clip = vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    vec4 view = iProjectionMat * clip;
+    return view.xyz / view.w;
+}
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
 
 void main() { // Positions are in view-space
-    vec3 FragPos = texture(gPositionDepth, TexCoords).xyz;
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
-    vec3 Diffuse = texture(gAlbedo, TexCoords).rgb;
+    if (texture(gDepth, TexCoords).r == 1) // background: nothing to shade, the target keeps its clear value
+        discard;
+    vec3 FragPos = viewPosition(TexCoords);
+    vec3 Normal = octDecode(texture(gNormal, TexCoords).rg);
     
     vec3 wo  = normalize(-FragPos);
     vec3 wi = normalize(light.Position - FragPos);
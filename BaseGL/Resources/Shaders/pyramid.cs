@@ -0,0 +1,32 @@
+#version 450 core
+// One level of the min/max depth pyramid: r holds the nearest and g the farthest depth buffer value of the
+// texels covered at the level below. Level 0 copies the depth buffer.
+layout (local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D gDepth;
+uniform int level;
+layout (binding = 0, rg32f) uniform writeonly image2D dst;
+layout (binding = 1, rg32f) uniform readonly image2D src; // level - 1
+
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(dst);
+    if (any(greaterThanEqual(texel, size)))
+        return;
+    if (level == 0) {
+        float depth = texelFetch(gDepth, texel, 0).r;
+        imageStore(dst, texel, vec4(depth, depth, 0.0, 0.0));
+        return;
+    }
+    // 2x2 block of the level below, widened to 3 texels along the dimensions of odd size
+    ivec2 srcSize = imageSize(src);
+    ivec2 extent = ivec2(2) + (srcSize & 1) * ivec2(equal(texel, size - 1));
+    vec2 range = vec2(1.0, 0.0);
+    for (int y = 0; y < extent.y; ++y) {
+        for (int x = 0; x < extent.x; ++x) {
+            vec2 v = imageLoad(src, min(texel * 2 + ivec2(x, y), srcSize - 1)).rg;
+            range = vec2(min(range.x, v.x), max(range.y, v.y));
+        }
+    }
+    imageStore(dst, texel, vec4(range, 0.0, 0.0));
+}
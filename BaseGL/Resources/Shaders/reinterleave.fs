@@ -0,0 +1,14 @@
+#version 450 core
+// Gathers the SSDO of the 16 quarter-resolution layers back into a single image
+layout (location = 0) out vec3 DirectLight;
+layout (location = 1) out vec3 IndirectLight;
+
+uniform sampler2DArray directLayers;
+uniform sampler2DArray indirectLayers;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec3 layerTexel = ivec3(texel / 4, (texel.x & 3) + 4 * (texel.y & 3));
+    DirectLight = texelFetch(directLayers, layerTexel, 0).rgb;
+    IndirectLight = texelFetch(indirectLayers, layerTexel, 0).rgb;
+}
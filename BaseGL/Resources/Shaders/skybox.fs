@@ -1,10 +0,0 @@
-#version 450 core
-in vec3 TexCoords;
-out vec4 color;
-
-uniform samplerCube skybox;
-
-void main() {
-    color = texture(skybox, TexCoords);
-}
-
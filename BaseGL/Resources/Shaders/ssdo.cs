@@ -0,0 +1,124 @@
+#version 450 core
+// Fused direct and indirect SSDO (see ssdo.fs) on the deinterleaved G-buffer. All the pixels of a layer share
+// the same rotation of the kernel, and their samples are looked up in the same layer: neighboring invocations
+// fetch neighboring texels, so the texture cache stays effective for large radii.
+layout (local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2DArray depthLayers;
+uniform sampler2DArray normalLayers;
+uniform sampler2D texNoise; // 4x4 blue noise: rotation of the kernel (R), and offset of its temporal subset (G)
+uniform samplerCube skybox;
+uniform sampler2D texLighting;
+layout (binding = 0, rgba8) uniform writeonly image2DArray directLayers;
+layout (binding = 1, rgba8) uniform writeonly image2DArray indirectLayers;
+
+uniform ivec2 resolution; // of the interleaved image
+uniform vec3 samples[64];
+uniform int sampleCount = 64;
+uniform int sampleOffset = 0;
+uniform int sampleStride = 1;
+uniform float radius = 1.0;
+// Samples drawn with a cosine-weighted density: the cosine factor of the sky light cancels with it,
+// leaving the ratio 1/2 of the uniform density to the cosine-weighted one
+uniform bool cosineKernel = false;
+// Offset of the rotations, stepped by the golden ratio each frame of the temporal mode
+uniform float noiseOffset = 0.0;
+
+uniform mat4 projectionMat;
+uniform mat4 iProjectionMat; // clip to view-space
+uniform mat4 iViewMat; // view to world-space
+
+// Sky seen by an unoccluded sample: the raw cube map, a lookup in the prefiltered environment over the cone
+// of directions covered by one sample of the kernel, or the spherical harmonics projection of the environment
+#define SKY_RAW 0
+#define SKY_CONE 1
+#define SKY_SH 2
+uniform int skyLookup = SKY_RAW;
+uniform vec3 shRadiance[9];
+
+vec3 skyRadiance(vec3 direction, float kernelSize) {
+    if (skyLookup == SKY_SH) {
+        vec3 d = normalize(direction);
+        vec3 c = shRadiance[0] * 0.282095
+               + (shRadiance[1] * d.y + shRadiance[2] * d.z + shRadiance[3] * d.x) * 0.488603
+               + (shRadiance[4] * d.x * d.y + shRadiance[5] * d.y * d.z + shRadiance[7] * d.x * d.z) * 1.092548
+               + shRadiance[6] * 0.315392 * (3.0 * d.z * d.z - 1.0)
+               + shRadiance[8] * 0.546274 * (d.x * d.x - d.y * d.y);
+        return max(c, vec3(0.0));
+    }
+    if (skyLookup == SKY_CONE) {
+        // level whose texels cover the solid angle of a sample, 4 pi / (6 size^2) = 2 pi / kernelSize
+        float level = log2(float(textureSize(skybox, 0).x) * sqrt(3.0 / kernelSize));
+        return textureLod(skybox, direction, level).rgb;
+    }
+    return textureLod(skybox, direction, 0.0).rgb;
+}
+
+vec3 viewPosition(vec2 uv, float depth) {
+    vec4 clip = vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec4 view = iProjectionMat * clip;
+    return view.xyz / view.w;
+}
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main() {
+    ivec3 texel = ivec3(gl_GlobalInvocationID);
+    ivec2 layerSize = textureSize(depthLayers, 0).xy;
+    if (any(greaterThanEqual(texel.xy, layerSize)))
+        return;
+    ivec2 shift = ivec2(texel.z & 3, texel.z >> 2); // position of the layer's pixels within the 4x4 blocks
+    vec2 uv = (vec2(texel.xy * 4 + shift) + 0.5) / vec2(resolution);
+
+    float depth = texelFetch(depthLayers, texel, 0).r;
+    if (depth == 1) { // background: the clear value of the fragment SSDO passes
+        imageStore(directLayers, texel, vec4(0.0));
+        imageStore(indirectLayers, texel, vec4(0.0));
+        return;
+    }
+    vec3 fragPos = viewPosition(uv, depth);
+    vec3 normal = octDecode(texelFetch(normalLayers, texel, 0).rg);
+    vec2 noise = texelFetch(texNoise, shift, 0).rg;
+    float angle = 6.2831853 * fract(noise.r + noiseOffset);
+    vec3 randomVec = vec3(cos(angle), sin(angle), 0.0);
+    int subset = (sampleOffset + int(noise.g * sampleStride)) % sampleStride;
+    // create TBN change-of-basis matrix: from tangent-space to view-space
+    vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+    vec3 bitangent = cross(normal, tangent);
+    mat3 TBN = mat3(tangent, bitangent, normal);
+    vec3 directLight = vec3(0.0);
+    vec3 indirectLight = vec3(0.0);
+
+    for (int k = 0; k < sampleCount; ++k) {
+        vec3 samplePos = fragPos + TBN * samples[subset + k * sampleStride] * radius;
+
+        // project sample position, and look it up in the same layer
+        vec4 offset = projectionMat * vec4(samplePos, 1.0);
+        vec2 sampleUV = offset.xy / offset.w * 0.5 + 0.5;
+        ivec2 sampleTexel = clamp(ivec2(round((sampleUV * vec2(resolution) - 0.5 - vec2(shift)) / 4.0)),
+                                  ivec2(0), layerSize - 1);
+        vec2 occluderUV = (vec2(sampleTexel * 4 + shift) + 0.5) / vec2(resolution);
+
+        float depth = texelFetch(depthLayers, ivec3(sampleTexel, texel.z), 0).r;
+        vec3 occluderPos = viewPosition(occluderUV, depth);
+
+        if (occluderPos.z >= samplePos.z && depth != 1) { // occluded: light bounced off the occluder
+            vec3 occluderNormal = octDecode(texelFetch(normalLayers, ivec3(sampleTexel, texel.z), 0).rg);
+            vec3 occluderColor = texture(texLighting, occluderUV).rgb;
+            indirectLight += max(dot(occluderNormal, normalize(fragPos - occluderPos)), 0.0) * occluderColor;
+        } else { // behind the surface, or nothing drawn: the sky is visible
+            vec3 direction = samplePos - fragPos;
+            vec3 skyboxColor = skyRadiance((iViewMat * vec4(direction, 0.0)).xyz, float(sampleCount * sampleStride));
+            directLight += skyboxColor * (cosineKernel ? 0.5 : dot(normal, normalize(direction)));
+        }
+    }
+
+    imageStore(directLayers, texel, vec4(directLight / sampleCount, 1.0));
+    imageStore(indirectLayers, texel, vec4(20 * indirectLight / sampleCount, 1.0));
+}
@@ -0,0 +1,173 @@
+#version 450 core
+// Direct and indirect SSDO in a single pass: both walk the same kernel around the same fragment,
+// so each sample is projected and its depth fetched once. A sample in front of the surface
+// occludes the sky and bounces light; any other sample sees the sky.
+layout (location = 0) out vec3 DirectLight;
+layout (location = 1) out vec3 IndirectLight;
+layout (location = 2) out float SampleCount; // fraction of the 64-sample kernel evaluated, for the debug view
+in vec2 TexCoords;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform sampler2D texNoise; // blue noise: rotation of the kernel (R), and offset of its temporal subset (G)
+uniform samplerCube skybox;
+uniform sampler2D texLighting;
+uniform sampler2D depthPyramid; // min/max depth mip chain, see pyramid.cs
+
+uniform vec3 samples[64];
+// Samples used this frame: sampleOffset + k * sampleStride for k < sampleCount. The temporal mode
+// walks a different subset of the kernel each frame, and accumulates them over frames.
+uniform int sampleCount = 64;
+uniform int sampleOffset = 0;
+uniform int sampleStride = 1;
+uniform float radius = 1.0;
+// Samples drawn with a cosine-weighted density: the cosine factor of the sky light cancels with it,
+// leaving the ratio 1/2 of the uniform density to the cosine-weighted one
+uniform bool cosineKernel = false;
+// Offset of the rotations, stepped by the golden ratio each frame of the temporal mode
+uniform float noiseOffset = 0.0;
+
+// With the pyramid, a sample reads the level at which its distance to the fragment spans 2^MIP_OFFSET texels,
+// successive samples alternating the nearest and the farthest depth of the level texel. Horizon marching tests marchSteps points
+// on the way to each sample, against the nearest depth, and bounces light off the first one found occluded.
+#define MIP_OFFSET 3
+uniform bool usePyramid = false;
+uniform int maxLevel = 0;
+uniform int marchSteps = 0;
+
+// The samples are evaluated in STAGES interleaved stages, each spanning all the radii of the kernel.
+// In adaptive mode, the budget shrinks with the projected size of the kernel (a kernel covering few texels
+// gains nothing from many samples), and only pixels whose first stage shows a partial occlusion, or which
+// lie on a depth discontinuity, go on with the other stages.
+#define STAGES 4
+uniform bool adaptive = false;
+uniform float varianceThreshold = 0.05; // of the occlusion of the first stage samples
+uniform float discontinuityThreshold = 0.05; // depth difference with the neighbor pixels, relative to the view depth
+
+uniform mat4 projectionMat;
+uniform mat4 iProjectionMat; // clip to view-space
+uniform mat4 iViewMat; // view to world-space
+
+// Sky seen by an unoccluded sample: the raw cube map, a lookup in the prefiltered environment over the cone
+// of directions covered by one sample of the kernel, or the spherical harmonics projection of the environment
+#define SKY_RAW 0
+#define SKY_CONE 1
+#define SKY_SH 2
+uniform int skyLookup = SKY_RAW;
+uniform vec3 shRadiance[9];
+
+vec3 skyRadiance(vec3 direction, float kernelSize) {
+    if (skyLookup == SKY_SH) {
+        vec3 d = normalize(direction);
+        vec3 c = shRadiance[0] * 0.282095
+               + (shRadiance[1] * d.y + shRadiance[2] * d.z + shRadiance[3] * d.x) * 0.488603
+               + (shRadiance[4] * d.x * d.y + shRadiance[5] * d.y * d.z + shRadiance[7] * d.x * d.z) * 1.092548
+               + shRadiance[6] * 0.315392 * (3.0 * d.z * d.z - 1.0)
+               + shRadiance[8] * 0.546274 * (d.x * d.x - d.y * d.y);
+        return max(c, vec3(0.0));
+    }
+    if (skyLookup == SKY_CONE) {
+        // level whose texels cover the solid angle of a sample, 4 pi / (6 size^2) = 2 pi / kernelSize
+        float level = log2(float(textureSize(skybox, 0).x) * sqrt(3.0 / kernelSize));
+        return textureLod(skybox, direction, level).rgb;
+    }
+    return textureLod(skybox, direction, 0.0).rgb;
+}
+
+vec3 viewPosition(vec2 uv, float depth) {
+    vec4 clip = vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec4 view = iProjectionMat * clip;
+    return view.xyz / view.w;
+}
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// Depth buffer value around uv, from the pyramid level matching the given distance in pixels
+float depthAt(vec2 uv, float pixels, bool nearest) {
+    if (!usePyramid)
+        return texture(gDepth, uv).r;
+    int level = clamp(findMSB(int(pixels)) - MIP_OFFSET, 0, maxLevel);
+    ivec2 size = textureSize(depthPyramid, level);
+    vec2 range = texelFetch(depthPyramid, clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1), level).rg;
+    return nearest ? range.x : range.y;
+}
+
+void main() {
+    float depth = texture(gDepth, TexCoords).r;
+    vec3 fragPos = viewPosition(TexCoords, depth);
+    // before any discard, which would leave the derivatives undefined on the silhouettes
+    bool edge = max(abs(dFdx(fragPos.z)), abs(dFdy(fragPos.z))) > discontinuityThreshold * abs(fragPos.z);
+    if (depth == 1) // background: nothing to shade, the target keeps its clear value
+        discard;
+    vec2 noiseScale = textureSize(gNormal,0) / textureSize(texNoise,0);
+    vec3 normal = octDecode(texture(gNormal, TexCoords).rg);
+    vec2 noise = texture(texNoise, TexCoords * noiseScale).rg;
+    float angle = 6.2831853 * fract(noise.r + noiseOffset);
+    vec3 randomVec = vec3(cos(angle), sin(angle), 0.0);
+    // neighboring pixels walk different subsets, which the temporal accumulation and the blur average
+    int subset = (sampleOffset + int(noise.g * sampleStride)) % sampleStride;
+    // create TBN change-of-basis matrix: from tangent-space to view-space
+    vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+    vec3 bitangent = cross(normal, tangent);
+    mat3 TBN = mat3(tangent, bitangent, normal);
+    vec2 resolution = vec2(textureSize(gDepth, 0));
+    vec3 directLight = vec3(0.0);
+    vec3 indirectLight = vec3(0.0);
+
+    int stageSize = max(sampleCount / STAGES, 1);
+    int budget = sampleCount;
+    if (adaptive) {
+        float kernelPixels = radius * projectionMat[1][1] * 0.5 * resolution.y / abs(fragPos.z);
+        budget = clamp(int(kernelPixels * kernelPixels), stageSize, sampleCount);
+    }
+    int taken = 0;
+    int occludedCount = 0;
+
+    for (int stage = 0; stage < STAGES && stage * stageSize < budget; ++stage) {
+        if (adaptive && stage == 1) {
+            float p = float(occludedCount) / taken;
+            if (p * (1.0 - p) <= varianceThreshold && !edge)
+                break;
+        }
+        for (int k = stage; k < sampleCount; k += STAGES) {
+            vec3 samplePos = fragPos + TBN * samples[subset + k * sampleStride] * radius;
+            taken++;
+
+            // march towards the sample (or only test it), projecting each point to get its position on screen
+            bool occluded = false;
+            vec2 occluderUV;
+            vec3 occluderPos;
+            int steps = max(marchSteps, 1);
+            for (int s = 1; s <= steps && !occluded; ++s) {
+                vec3 pos = mix(fragPos, samplePos, float(s) / steps);
+                vec4 offset = projectionMat * vec4(pos, 1.0);
+                occluderUV = offset.xy / offset.w * 0.5 + 0.5;
+                float pixels = length((occluderUV - TexCoords) * resolution);
+                float depth = depthAt(occluderUV, pixels, marchSteps > 0 || (taken & 1) == 0);
+                occluderPos = viewPosition(occluderUV, depth);
+                occluded = occluderPos.z >= pos.z && depth != 1;
+            }
+
+            if (occluded) { // light bounced off the occluder
+                occludedCount++;
+                vec3 occluderNormal = octDecode(texture(gNormal, occluderUV).rg);
+                vec3 occluderColor = texture(texLighting, occluderUV).rgb;
+                indirectLight += max(dot(occluderNormal, normalize(fragPos - occluderPos)), 0.0) * occluderColor;
+            } else { // behind the surface, or nothing drawn: the sky is visible
+                vec3 direction = samplePos - fragPos;
+                vec3 skyboxColor = skyRadiance((iViewMat * vec4(direction, 0.0)).xyz, float(budget * sampleStride));
+                directLight += skyboxColor * (cosineKernel ? 0.5 : dot(normal, normalize(direction)));
+            }
+        }
+    }
+
+    DirectLight = directLight / taken;
+    IndirectLight = 20 * indirectLight / taken;
+    SampleCount = float(taken) / 64.0;
+}
@@ -0,0 +1,91 @@
+#version 450 core
+// Temporal accumulation of the SSDO. The history of the previous frames is reprojected to the current pixel
+// through the previous view and projection, and blended with the current samples, unless the surface found
+// there differs in depth or normal (disocclusion, or first frame).
+layout (location = 0) out vec4 AccumDirect; // rgb: light, a: number of accumulated frames
+layout (location = 1) out vec4 AccumIndirect;
+layout (location = 2) out float AccumDepth; // view-space z, 0 for the background
+layout (location = 3) out vec2 AccumNormal; // world-space, octahedral-encoded
+in vec2 TexCoords;
+
+uniform sampler2D ssdoTex;
+uniform sampler2D ssdoIndirectTex;
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform sampler2D historyDirect;
+uniform sampler2D historyIndirect;
+uniform sampler2D historyDepth;
+uniform sampler2D historyNormal;
+
+uniform mat4 iProjectionMat; // clip to view-space
+uniform mat4 iViewMat; // view to world-space
+uniform mat4 prevViewMat;
+uniform mat4 prevProjectionMat;
+uniform bool historyValid;
+uniform int maxFrames; // frames for the rotating kernel to cover the whole sample set
+uniform float depthTolerance; // relative to the view depth
+uniform float normalTolerance; // minimum cosine
+
+vec3 viewPosition(vec2 uv, float depth) {
+    vec4 clip = vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec4 view = iProjectionMat * clip;
+    return view.xyz / view.w;
+}
+
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return e * 0.5 + 0.5;
+}
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main() {
+    vec3 direct = texture(ssdoTex, TexCoords).rgb;
+    vec3 indirect = texture(ssdoIndirectTex, TexCoords).rgb;
+    float depth = texture(gDepth, TexCoords).r;
+    vec3 normal = normalize(mat3(iViewMat) * octDecode(texture(gNormal, TexCoords).rg));
+    AccumNormal = octEncode(normal);
+    if (depth == 1) { // background
+        AccumDirect = vec4(direct, 1.0);
+        AccumIndirect = vec4(indirect, 1.0);
+        AccumDepth = 0.0;
+        return;
+    }
+    vec3 viewPos = viewPosition(TexCoords, depth);
+    AccumDepth = viewPos.z;
+
+    // Where the surface was in the previous frame
+    vec4 prevView = prevViewMat * (iViewMat * vec4(viewPos, 1.0));
+    vec4 prevClip = prevProjectionMat * prevView;
+    vec2 prevUV = prevClip.xy / prevClip.w * 0.5 + 0.5;
+
+    float frames = 0.0;
+    vec4 prevDirect = vec4(0.0), prevIndirect = vec4(0.0);
+    if (historyValid && all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0)))) {
+        float prevDepth = texture(historyDepth, prevUV).r;
+        vec3 prevNormal = octDecode(texture(historyNormal, prevUV).rg);
+        if (prevDepth != 0.0 && abs(prevDepth - prevView.z) < depthTolerance * abs(prevView.z)
+            && dot(prevNormal, normal) > normalTolerance) {
+            prevDirect = texture(historyDirect, prevUV);
+            prevIndirect = texture(historyIndirect, prevUV);
+            frames = prevDirect.a;
+        }
+    }
+    // Exact mean of the frames since the history was last rejected, up to maxFrames frames, then an exponential moving
+    // average of weight 1 / maxFrames. The history is reset once the view stops changing, so that a still view ends up
+    // with the mean of maxFrames consecutive frames, i.e., of each subset of the kernel once.
+    frames = min(frames + 1.0, float(maxFrames));
+    AccumDirect = vec4(mix(prevDirect.rgb, direct, 1.0 / frames), frames);
+    AccumIndirect = vec4(mix(prevIndirect.rgb, indirect, 1.0 / frames), frames);
+}
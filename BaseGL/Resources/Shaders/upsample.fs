@@ -0,0 +1,69 @@
+#version 450 core
+out vec3 FragColor;
+in vec2 TexCoords;
+
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;
+uniform sampler2D lowDepth;
+uniform sampler2D lowNormal;
+uniform sampler2D tex; // low resolution signal
+
+uniform mat4 projectionMat;
+
+const float depthSigma = 0.05; // relative to the view depth
+const float normalPower = 16.0;
+
+float viewDepth(float depth) {
+    return -projectionMat[3][2] / (depth * 2.0 - 1.0 + projectionMat[2][2]);
+}
+
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// Joint bilateral upsampling: the bilinear weights of the 4 nearest low resolution pixels are
+// modulated by their depth and normal similarity with the full resolution pixel
+void main() {
+    float depth = texture(gDepth, TexCoords).r;
+    if (depth == 1) { // background: only the skybox is displayed
+        FragColor = texture(tex, TexCoords).rgb;
+        return;
+    }
+    float z = viewDepth(depth);
+    vec3 normal = octDecode(texture(gNormal, TexCoords).rg);
+
+    ivec2 lowSize = textureSize(tex, 0);
+    vec2 p = TexCoords * vec2(lowSize) - 0.5;
+    ivec2 base = ivec2(floor(p));
+    vec2 f = fract(p);
+
+    vec3 acc = vec3(0.0);
+    float total = 0.0;
+    float bestDistance = 1e30;
+    vec3 nearest = vec3(0.0);
+    for (int i = 0; i < 4; ++i) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), lowSize - 1);
+        float sampleZ = viewDepth(texelFetch(lowDepth, texel, 0).r);
+        vec3 sampleNormal = octDecode(texelFetch(lowNormal, texel, 0).rg);
+        vec3 value = texelFetch(tex, texel, 0).rgb;
+
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float dz = abs(sampleZ - z) / (depthSigma * abs(z));
+        float w = bilinear.x * bilinear.y
+                * exp(-dz * dz)
+                * pow(max(dot(normal, sampleNormal), 0.0), normalPower);
+        acc += w * value;
+        total += w;
+        if (abs(sampleZ - z) < bestDistance) {
+            bestDistance = abs(sampleZ - z);
+            nearest = value;
+        }
+    }
+    // No similar low resolution sample (thin features): take the closest in depth
+    FragColor = total > 1e-4 ? acc / total : nearest;
+}
@@ -0,0 +1,209 @@
+// Benchmark of the renderer (BaseGL_bench): the renderer of Main.cpp, with this main instead of the interactive one.
+// It renders headless, so that it runs on any machine with EGL, e.g., with Mesa's llvmpipe.
+#define BASEGL_BENCH
+#include "Main.cpp"
+
+#include <dirent.h>
+
+#include "BenchReport.h"
+
+static const std::string MODELS_PATH ("Resources/Models");
+static const std::string BENCH_FILENAME ("bench.json");
+static const int BENCH_FRAMES = 60;
+static const double BENCH_TOLERANCE = 0.1;
+
+struct Resolution {
+	std::string name;
+	int width;
+	int height;
+};
+
+static const std::vector<Resolution> BENCH_RESOLUTIONS = {
+	{ "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "1440p", 2560, 1440 }, { "4k", 3840, 2160 }
+};
+
+// The .off files of a directory, sorted
+std::vector<std::string> listModels (const std::string & directory) {
+	std::vector<std::string> models;
+	if (DIR * dir = opendir (directory.c_str ())) {
+		while (dirent * entry = readdir (dir)) {
+			const std::string name = entry->d_name;
+			if (name.size () > 4 && name.compare (name.size () - 4, 4, ".off") == 0)
+				models.push_back (directory + "/" + name);
+		}
+		closedir (dir);
+	}
+	std::sort (models.begin (), models.end ());
+	return models;
+}
+
+std::vector<std::string> splitList (const std::string & list) {
+	std::vector<std::string> items;
+	std::istringstream in (list);
+	std::string item;
+	while (std::getline (in, item, ','))
+		if (!item.empty ())
+			items.push_back (item);
+	return items;
+}
+
+// Renders the given number of frames along the camera path, after one frame at its start, which is not measured:
+// the first frame at a resolution allocates the transient targets. The profiler waits for the GPU, so that every frame counts.
+Bench::Run runPath (const std::string & path, int frames) {
+	auto setPose = [] (const Headless::Pose & pose) {
+		cameraPtr->setTranslation (pose.translation);
+		cameraPtr->setRotation (glm::radians (pose.rotation));
+	};
+	setPose (Bench::cameraPath (path, 0.0));
+	render ();
+	glFinish ();
+	profilerPtr = std::make_shared<Profiler> (frames);
+	profilerPtr->setBlocking (true);
+	frameGraphPtr->setProfiler (profilerPtr);
+	for (int frame = 0; frame < frames; frame++) {
+		setPose (Bench::cameraPath (path, static_cast<double> (frame) / frames));
+		render ();
+	}
+	profilerPtr->wait ();
+
+	Bench::Run run;
+	run.path = path;
+	run.width = headlessWidth;
+	run.height = headlessHeight;
+	run.frames = frames;
+	run.passes = profilerPtr->stats ();
+	run.memory.renderTargets = renderTargetsPtr->allocatedBytes ();
+	run.memory.mesh = meshPtr->gpuBytes ();
+	run.memory.sky = environmentsPtr->residentBytes ();
+	run.memory.resident = Bench::residentBytes ();
+	return run;
+}
+
+void usage (const char * command) {
+	std::cerr << "Usage : " << command << " [<model.off>...] [--frames=<count>] [--resolutions=<list>] [--paths=<list>]" << std::endl
+			  << "        [--output=<file>] [--compare=<baseline>] [--results=<file>] [--tolerance=<percent>]" << std::endl
+			  << "    Renders each model (default: every model of " << MODELS_PATH << ") along each camera path (orbit, zoom, pan)" << std::endl
+			  << "    at each resolution (comma-separated, e.g., 720p,1080p,1440p,4k or 640x480; default: 720p to 4k), " << BENCH_FRAMES << std::endl
+			  << "    frames each by default, and writes the GPU time of the passes, the CPU time, the load time and the memory" << std::endl
+			  << "    to " << BENCH_FILENAME << "." << std::endl
+			  << "    --compare then flags the regressions against a baseline written by an earlier version, beyond the tolerance" << std::endl
+			  << "    (" << 100.0 * BENCH_TOLERANCE << "% by default), and fails if there are any. With --results, the given results are compared" << std::endl
+			  << "    instead, without rendering." << std::endl;
+	std::exit (EXIT_FAILURE);
+}
+
+int main (int argc, char ** argv) {
+	std::vector<std::string> models;
+	std::vector<Resolution> resolutions;
+	std::vector<std::string> paths = Bench::PATHS;
+	int frames = BENCH_FRAMES;
+	std::string outputFilename = BENCH_FILENAME, baselineFilename, resultsFilename;
+	double tolerance = BENCH_TOLERANCE;
+	for (int i = 1; i < argc; i++) {
+		const std::string argument = argv[i];
+		const size_t equal = argument.find ('=');
+		const std::string option = argument.substr (0, equal), value = equal == std::string::npos ? "" : argument.substr (equal + 1);
+		if (option == "--frames") {
+			frames = std::atoi (value.c_str ());
+			if (frames <= 0)
+				usage (argv[0]);
+		} else if (option == "--resolutions") {
+			for (const std::string & name : splitList (value)) {
+				auto preset = std::find_if (BENCH_RESOLUTIONS.begin (), BENCH_RESOLUTIONS.end (), [&] (const Resolution & r) {
+					return r.name == name;
+				});
+				Resolution resolution = { name, 0, 0 };
+				if (preset != BENCH_RESOLUTIONS.end ())
+					resolution = *preset;
+				else if (std::sscanf (name.c_str (), "%dx%d", &resolution.width, &resolution.height) != 2
+						 || resolution.width <= 0 || resolution.height <= 0)
+					usage (argv[0]);
+				resolutions.push_back (resolution);
+			}
+		} else if (option == "--paths") {
+			paths = splitList (value);
+			for (const std::string & path : paths)
+				if (std::find (Bench::PATHS.begin (), Bench::PATHS.end (), path) == Bench::PATHS.end ())
+					usage (argv[0]);
+		} else if (option == "--output" && !value.empty ())
+			outputFilename = value;
+		else if (option == "--compare" && !value.empty ())
+			baselineFilename = value;
+		else if (option == "--results" && !value.empty ())
+			resultsFilename = value;
+		else if (option == "--tolerance") {
+			tolerance = std::atof (value.c_str ()) / 100.0;
+			if (tolerance <= 0.0)
+				usage (argv[0]);
+		} else if (argument.compare (0, 2, "--") == 0)
+			usage (argv[0]);
+		else
+			models.push_back (argument);
+	}
+	if (!resultsFilename.empty () && baselineFilename.empty ())
+		usage (argv[0]);
+
+	Bench::Report report;
+	if (!resultsFilename.empty ()) {
+		try {
+			report = Bench::readJson (resultsFilename);
+		} catch (std::exception & e) {
+			std::cerr << "ERROR: " << e.what () << std::endl;
+			return EXIT_FAILURE;
+		}
+	} else {
+		if (models.empty ())
+			models = listModels (MODELS_PATH);
+		if (resolutions.empty ())
+			resolutions = BENCH_RESOLUTIONS;
+		if (models.empty () || paths.empty ())
+			usage (argv[0]);
+		headlessWidth = resolutions[0].width;
+		headlessHeight = resolutions[0].height;
+		init (models[0]);
+		report.renderer = reinterpret_cast<const char *> (glGetString (GL_RENDERER));
+		for (const std::string & model : models) {
+			// Loaded again for the first model, so that all of them are timed alike
+			glFinish ();
+			const auto start = std::chrono::steady_clock::now ();
+			loadMesh (model);
+			glFinish ();
+			const double loadMilliseconds = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+			for (const Resolution & resolution : resolutions) {
+				headlessWidth = resolution.width;
+				headlessHeight = resolution.height;
+				renderTargetsPtr->resize (headlessWidth, headlessHeight);
+				cameraPtr->setAspectRatio (static_cast<float> (headlessWidth) / static_cast<float> (headlessHeight));
+				historyValid = false;
+				for (const std::string & path : paths) {
+					Bench::Run run = runPath (path, frames);
+					run.model = model.substr (model.find_last_of ("/\\") + 1);
+					run.loadMilliseconds = loadMilliseconds;
+					report.runs.push_back (run);
+					const Profiler::Stats & gpu = *std::find_if (run.passes.begin (), run.passes.end (), [] (const Profiler::Stats & s) {
+						return s.name == Profiler::GPU_FRAME;
+					});
+					std::cout << " > " << run.model << " " << path << " " << headlessWidth << "x" << headlessHeight << ": GPU frame p50 "
+							  << gpu.p50 << " ms, p95 " << gpu.p95 << " ms" << std::endl;
+				}
+			}
+		}
+		report.peakResident = Bench::peakResidentBytes ();
+		clear ();
+		if (!Bench::writeJson (outputFilename, report)) {
+			std::cerr << "ERROR: Cannot write " << outputFilename << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::cout << " > " << report.runs.size () << " runs written to " << outputFilename << std::endl;
+	}
+
+	if (baselineFilename.empty ())
+		return EXIT_SUCCESS;
+	try {
+		Bench::Report baseline = Bench::readJson (baselineFilename);
+		return Bench::compare (baseline, report, tolerance, std::cout) > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	} catch (std::exception & e) {
+		std::cerr << "ERROR: " << e.what () << std::endl;
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,302 @@
+#include "BenchReport.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+
+using namespace std;
+
+// Differences below these are noise of the timers, whatever the tolerance
+static const double NOISE_MILLISECONDS = 0.05;
+static const double LOAD_NOISE_MILLISECONDS = 2.0;
+
+namespace Bench {
+
+const std::vector<std::string> PATHS = { "orbit", "zoom", "pan" };
+
+Headless::Pose cameraPath (const std::string & path, double t) {
+	const double pi = 3.14159265358979323846;
+	Headless::Pose pose;
+	if (path == "orbit") {
+		pose.translation = glm::vec3 (0.0, 0.0, 3.0);
+		pose.rotation = glm::vec3 (0.0, 360.0 * t, 0.0);
+	} else if (path == "zoom") {
+		pose.translation = glm::vec3 (0.0, 0.0, 3.0 - 1.8 * std::sin (pi * t));
+		pose.rotation = glm::vec3 (-15.0, 30.0, 0.0);
+	} else if (path == "pan") {
+		pose.translation = glm::vec3 (0.8 * std::sin (2.0 * pi * t), 0.4 * std::sin (4.0 * pi * t), 3.0);
+	} else
+		throw std::runtime_error ("[Bench][cameraPath] Unknown camera path " + path);
+	return pose;
+}
+
+// Field of /proc/self/status, in kB
+static size_t statusBytes (const std::string & field) {
+	ifstream in ("/proc/self/status");
+	std::string line;
+	while (std::getline (in, line))
+		if (line.compare (0, field.size () + 1, field + ":") == 0)
+			return size_t (std::strtoull (line.c_str () + field.size () + 1, nullptr, 10)) * 1024;
+	return 0;
+}
+
+size_t residentBytes () {
+	return statusBytes ("VmRSS");
+}
+
+size_t peakResidentBytes () {
+	return statusBytes ("VmHWM");
+}
+
+static std::string quoted (const std::string & text) {
+	std::string result = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			result += '\\';
+		result += c;
+	}
+	return result + "\"";
+}
+
+bool writeJson (const std::string & filename, const Report & report) {
+	ofstream out (filename.c_str ());
+	if (!out)
+		return false;
+	out << std::setprecision (6);
+	out << "{" << std::endl
+		<< "  \"renderer\": " << quoted (report.renderer) << "," << std::endl
+		<< "  \"peak_resident_bytes\": " << report.peakResident << "," << std::endl
+		<< "  \"runs\": [";
+	for (size_t r = 0; r < report.runs.size (); r++) {
+		const Run & run = report.runs[r];
+		out << (r ? "," : "") << std::endl
+			<< "    {" << std::endl
+			<< "      \"model\": " << quoted (run.model) << ", \"path\": " << quoted (run.path)
+			<< ", \"width\": " << run.width << ", \"height\": " << run.height << ", \"frames\": " << run.frames << "," << std::endl
+			<< "      \"load_ms\": " << run.loadMilliseconds << "," << std::endl
+			<< "      \"memory\": { \"render_target_bytes\": " << run.memory.renderTargets << ", \"mesh_bytes\": " << run.memory.mesh
+			<< ", \"sky_bytes\": " << run.memory.sky << ", \"resident_bytes\": " << run.memory.resident << " }," << std::endl
+			<< "      \"passes\": [";
+		for (size_t p = 0; p < run.passes.size (); p++) {
+			const Profiler::Stats & s = run.passes[p];
+			out << (p ? "," : "") << std::endl
+				<< "        { \"name\": " << quoted (s.name) << ", \"samples\": " << s.samples << ", \"mean_ms\": " << s.mean
+				<< ", \"p50_ms\": " << s.p50 << ", \"p95_ms\": " << s.p95 << ", \"p99_ms\": " << s.p99 << " }";
+		}
+		out << std::endl << "      ]" << std::endl << "    }";
+	}
+	out << std::endl << "  ]" << std::endl << "}" << std::endl;
+	return static_cast<bool> (out);
+}
+
+// Just enough JSON to read back the reports
+struct Value {
+	enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+	Type type = NUL;
+	double number = 0.0;
+	std::string string;
+	std::vector<Value> items;
+	std::vector<std::pair<std::string, Value>> members;
+
+	const Value & operator[] (const std::string & key) const {
+		for (const auto & member : members)
+			if (member.first == key)
+				return member.second;
+		throw std::runtime_error ("[Bench][readJson] Missing \"" + key + "\"");
+	}
+};
+
+class Parser {
+public:
+	explicit Parser (const std::string & text) : m_text (text) {}
+
+	Value parse () {
+		Value value = parseValue ();
+		skipSpaces ();
+		if (m_position != m_text.size ())
+			fail ("trailing characters");
+		return value;
+	}
+
+private:
+	void fail (const std::string & message) {
+		throw std::runtime_error ("[Bench][readJson] " + message + " at character " + std::to_string (m_position));
+	}
+
+	void skipSpaces () {
+		while (m_position < m_text.size () && std::isspace (static_cast<unsigned char> (m_text[m_position])))
+			m_position++;
+	}
+
+	bool accept (char c) {
+		skipSpaces ();
+		if (m_position < m_text.size () && m_text[m_position] == c) {
+			m_position++;
+			return true;
+		}
+		return false;
+	}
+
+	void expect (char c) {
+		if (!accept (c))
+			fail (std::string ("expected '") + c + "'");
+	}
+
+	std::string parseString () {
+		expect ('"');
+		std::string result;
+		while (m_position < m_text.size () && m_text[m_position] != '"') {
+			if (m_text[m_position] == '\\')
+				m_position++;
+			if (m_position < m_text.size ())
+				result += m_text[m_position++];
+		}
+		expect ('"');
+		return result;
+	}
+
+	Value parseValue () {
+		Value value;
+		skipSpaces ();
+		if (m_position >= m_text.size ())
+			fail ("unexpected end");
+		const char c = m_text[m_position];
+		if (c == '{') {
+			value.type = Value::OBJECT;
+			expect ('{');
+			if (!accept ('}')) {
+				do {
+					std::string key = parseString ();
+					expect (':');
+					value.members.emplace_back (key, parseValue ());
+				} while (accept (','));
+				expect ('}');
+			}
+		} else if (c == '[') {
+			value.type = Value::ARRAY;
+			expect ('[');
+			if (!accept (']')) {
+				do
+					value.items.push_back (parseValue ());
+				while (accept (','));
+				expect (']');
+			}
+		} else if (c == '"') {
+			value.type = Value::STRING;
+			value.string = parseString ();
+		} else if (m_text.compare (m_position, 4, "true") == 0 || m_text.compare (m_position, 5, "false") == 0) {
+			value.type = Value::BOOLEAN;
+			value.number = c == 't' ? 1.0 : 0.0;
+			m_position += c == 't' ? 4 : 5;
+		} else if (m_text.compare (m_position, 4, "null") == 0) {
+			m_position += 4;
+		} else {
+			value.type = Value::NUMBER;
+			char * end = nullptr;
+			value.number = std::strtod (m_text.c_str () + m_position, &end);
+			if (end == m_text.c_str () + m_position)
+				fail ("unexpected character");
+			m_position = end - m_text.c_str ();
+		}
+		return value;
+	}
+
+	const std::string & m_text;
+	size_t m_position = 0;
+};
+
+Report readJson (const std::string & filename) {
+	ifstream in (filename.c_str ());
+	if (!in)
+		throw std::runtime_error ("[Bench][readJson] Cannot open " + filename);
+	std::stringstream text;
+	text << in.rdbuf ();
+	const std::string content = text.str ();
+	Value root = Parser (content).parse ();
+	Report report;
+	report.renderer = root["renderer"].string;
+	report.peakResident = static_cast<size_t> (root["peak_resident_bytes"].number);
+	for (const Value & item : root["runs"].items) {
+		Run run;
+		run.model = item["model"].string;
+		run.path = item["path"].string;
+		run.width = static_cast<int> (item["width"].number);
+		run.height = static_cast<int> (item["height"].number);
+		run.frames = static_cast<int> (item["frames"].number);
+		run.loadMilliseconds = item["load_ms"].number;
+		const Value & memory = item["memory"];
+		run.memory.renderTargets = static_cast<size_t> (memory["render_target_bytes"].number);
+		run.memory.mesh = static_cast<size_t> (memory["mesh_bytes"].number);
+		run.memory.sky = static_cast<size_t> (memory["sky_bytes"].number);
+		run.memory.resident = static_cast<size_t> (memory["resident_bytes"].number);
+		for (const Value & pass : item["passes"].items)
+			run.passes.push_back ({ pass["name"].string, static_cast<size_t> (pass["samples"].number), pass["mean_ms"].number,
+									pass["p50_ms"].number, pass["p95_ms"].number, pass["p99_ms"].number });
+		report.runs.push_back (run);
+	}
+	return report;
+}
+
+static std::string runName (const Run & run) {
+	return run.model + " " + run.path + " " + std::to_string (run.width) + "x" + std::to_string (run.height);
+}
+
+size_t compare (const Report & baseline, const Report & current, double tolerance, std::ostream & out) {
+	size_t regressions = 0, improvements = 0, measures = 0;
+	// Flags a measure that changed by more than the tolerance and the noise
+	auto check = [&] (const std::string & name, double before, double after, double noise, const std::string & unit) {
+		measures++;
+		const double change = before > 0.0 ? after / before - 1.0 : 0.0;
+		if (std::abs (after - before) <= noise || std::abs (change) <= tolerance)
+			return;
+		const bool regressed = after > before;
+		(regressed ? regressions : improvements)++;
+		out << "    " << (regressed ? "REGRESSION " : "improvement ") << name << ": " << before << " -> " << after << " " << unit
+			<< " (" << std::showpos << std::setprecision (1) << 100.0 * change << "%" << std::noshowpos << std::setprecision (3)
+			<< ")" << std::endl;
+	};
+	out << "> Comparison with the baseline (" << baseline.renderer << "), tolerance " << 100.0 * tolerance << "%" << std::endl;
+	std::ios::fmtflags flags = out.flags ();
+	std::streamsize precision = out.precision ();
+	out << std::fixed << std::setprecision (3);
+	if (baseline.renderer != current.renderer)
+		out << "    Warning: measured on " << current.renderer << std::endl;
+	for (const Run & run : current.runs) {
+		auto base = std::find_if (baseline.runs.begin (), baseline.runs.end (), [&] (const Run & r) {
+			return r.model == run.model && r.path == run.path && r.width == run.width && r.height == run.height;
+		});
+		if (base == baseline.runs.end ()) {
+			out << "    " << runName (run) << ": not in the baseline" << std::endl;
+			continue;
+		}
+		const std::string prefix = runName (run) + " ";
+		for (const Profiler::Stats & pass : run.passes) {
+			auto before = std::find_if (base->passes.begin (), base->passes.end (), [&] (const Profiler::Stats & s) {
+				return s.name == pass.name;
+			});
+			if (before == base->passes.end ()) {
+				out << "    " << prefix << pass.name << ": not in the baseline" << std::endl;
+				continue;
+			}
+			check (prefix + pass.name + " p50", before->p50, pass.p50, NOISE_MILLISECONDS, "ms");
+			check (prefix + pass.name + " p95", before->p95, pass.p95, NOISE_MILLISECONDS, "ms");
+		}
+		check (prefix + "load", base->loadMilliseconds, run.loadMilliseconds, LOAD_NOISE_MILLISECONDS, "ms");
+		const Memory & a = base->memory, & b = run.memory;
+		check (prefix + "GPU memory", (a.renderTargets + a.mesh + a.sky) / 1048576.0, (b.renderTargets + b.mesh + b.sky) / 1048576.0,
+			   0.0, "MB");
+		if (a.resident > 0 && b.resident > 0)
+			check (prefix + "resident memory", a.resident / 1048576.0, b.resident / 1048576.0, 0.0, "MB");
+	}
+	out << "> " << regressions << " regressions, " << improvements << " improvements, out of " << measures << " measures" << std::endl;
+	out.flags (flags);
+	out.precision (precision);
+	return regressions;
+}
+
+}
@@ -0,0 +1,63 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "Profiler.h"
+#include "Headless.h"
+
+/// Results of the benchmark (BaseGL_bench): one run per model, camera path and resolution, each a fixed number of frames.
+/// They are written as JSON, and compared with the results of an earlier version to flag the regressions.
+namespace Bench {
+
+/// Deterministic camera paths around the standardized mesh: a full turn, a dolly in and back out, a sideways sweep
+extern const std::vector<std::string> PATHS;
+
+/// Pose of the camera on the path at time t in [0, 1]. Throws if the path is unknown.
+Headless::Pose cameraPath (const std::string & path, double t);
+
+/// Memory in use at the end of a run, in bytes
+struct Memory {
+	size_t renderTargets = 0; // GPU, aliased storage counted once
+	size_t mesh = 0; // GPU
+	size_t sky = 0; // GPU, the resident skies
+	size_t resident = 0; // CPU, the resident set of the process (0 if unknown)
+};
+
+struct Run {
+	std::string model;
+	std::string path;
+	int width = 0;
+	int height = 0;
+	int frames = 0;
+	double loadMilliseconds = 0.0; // reading, normals and upload of the model
+	Memory memory;
+	std::vector<Profiler::Stats> passes; // then the whole frame on the GPU and on the CPU, as Profiler::stats ()
+};
+
+struct Report {
+	std::string renderer; // GL_RENDERER
+	size_t peakResident = 0;
+	std::vector<Run> runs;
+};
+
+/// Resident set of the process, current and peak, in bytes. 0 where unknown.
+size_t residentBytes ();
+size_t peakResidentBytes ();
+
+/// Returns false on failure
+bool writeJson (const std::string & filename, const Report & report);
+
+/// Reads back a report of writeJson. Throws if the file cannot be read or is malformed.
+Report readJson (const std::string & filename);
+
+/// Compares the runs found in both reports: the median and 95th percentile of every pass, the load time and the memory.
+/// A measure regresses if it grew by more than the tolerance (e.g., 0.1 for 10%), and, for times, by more than the
+/// timer noise. Prints the regressions and improvements, and returns the number of regressions.
+size_t compare (const Report & baseline, const Report & current, double tolerance, std::ostream & out);
+
+}
+
+#endif // BENCH_REPORT_H
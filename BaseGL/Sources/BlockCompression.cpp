@@ -0,0 +1,142 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <glm/glm.hpp>
+
+using namespace std;
+
+namespace BlockCompression {
+
+size_t bc1Size (int width, int height) {
+	return size_t ((width + 3) / 4) * ((height + 3) / 4) * 8;
+}
+
+static uint16_t packRGB565 (const glm::vec3 & color) {
+	glm::vec3 c = glm::clamp (color, 0.f, 255.f);
+	return static_cast<uint16_t> ((int (c.r * 31.f / 255.f + .5f) << 11) | (int (c.g * 63.f / 255.f + .5f) << 5)
+	                              | int (c.b * 31.f / 255.f + .5f));
+}
+
+static glm::vec3 unpackRGB565 (uint16_t packed) {
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	return glm::vec3 ((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+// Chooses the nearest of the four colors between the endpoints (c0 > c1) for each texel.
+// Returns the squared error of the block, and the indices in bc1 order (texel i in bits 2i, 1 for c1, 2 and 3 in between).
+static float fitIndices (const glm::vec3 * texels, uint16_t c0, uint16_t c1, uint32_t & indices) {
+	glm::vec3 e0 = unpackRGB565 (c0), e1 = unpackRGB565 (c1);
+	glm::vec3 palette[4] = { e0, e1, (2.f * e0 + e1) / 3.f, (e0 + 2.f * e1) / 3.f };
+	float error = 0.f;
+	indices = 0;
+	for (int i = 0; i < 16; i++) {
+		int best = 0;
+		float bestDistance = 1e30f;
+		for (int p = 0; p < 4; p++) {
+			glm::vec3 d = texels[i] - palette[p];
+			float distance = glm::dot (d, d);
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				best = p;
+			}
+		}
+		error += bestDistance;
+		indices |= uint32_t (best) << (2 * i);
+	}
+	return error;
+}
+
+// Endpoints in the 4-color mode, which requires c0 > c1. Equal endpoints select the 3-color mode, where index 0 is still c0.
+static void orderEndpoints (uint16_t & c0, uint16_t & c1) {
+	if (c0 < c1)
+		std::swap (c0, c1);
+}
+
+static void encodeBlock (const glm::vec3 * texels, unsigned char * block) {
+	// Endpoints at the extent of the texels along their principal axis
+	glm::vec3 mean (0.f);
+	for (int i = 0; i < 16; i++)
+		mean += texels[i];
+	mean /= 16.f;
+	glm::mat3 covariance (0.f);
+	for (int i = 0; i < 16; i++) {
+		glm::vec3 d = texels[i] - mean;
+		covariance += glm::outerProduct (d, d);
+	}
+	glm::vec3 axis (1.f, 1.f, 1.f);
+	for (int iteration = 0; iteration < 8; iteration++) { // power iteration
+		axis = covariance * axis;
+		float length = glm::length (axis);
+		if (length < 1e-6f) {
+			axis = glm::vec3 (0.f);
+			break;
+		}
+		axis /= length;
+	}
+	float lo = 0.f, hi = 0.f;
+	for (int i = 0; i < 16; i++) {
+		float t = glm::dot (texels[i] - mean, axis);
+		lo = std::min (lo, t);
+		hi = std::max (hi, t);
+	}
+	uint16_t c0 = packRGB565 (mean + hi * axis), c1 = packRGB565 (mean + lo * axis);
+	orderEndpoints (c0, c1);
+	uint32_t indices;
+	float error = fitIndices (texels, c0, c1, indices);
+
+	// One least squares refinement of the endpoints for these indices: texel ~ w * e0 + (1 - w) * e1
+	if (c0 != c1) {
+		static const float WEIGHTS[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+		float aa = 0.f, ab = 0.f, bb = 0.f;
+		glm::vec3 ax (0.f), bx (0.f);
+		for (int i = 0; i < 16; i++) {
+			float w = WEIGHTS[(indices >> (2 * i)) & 3];
+			aa += w * w;
+			ab += w * (1.f - w);
+			bb += (1.f - w) * (1.f - w);
+			ax += w * texels[i];
+			bx += (1.f - w) * texels[i];
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::abs (determinant) > 1e-6f) {
+			uint16_t r0 = packRGB565 ((ax * bb - bx * ab) / determinant);
+			uint16_t r1 = packRGB565 ((bx * aa - ax * ab) / determinant);
+			orderEndpoints (r0, r1);
+			uint32_t refined;
+			float refinedError = fitIndices (texels, r0, r1, refined);
+			if (refinedError < error) {
+				c0 = r0;
+				c1 = r1;
+				indices = refined;
+			}
+		}
+	}
+	if (c0 == c1)
+		indices = 0;
+
+	block[0] = static_cast<unsigned char> (c0 & 0xFF);
+	block[1] = static_cast<unsigned char> (c0 >> 8);
+	block[2] = static_cast<unsigned char> (c1 & 0xFF);
+	block[3] = static_cast<unsigned char> (c1 >> 8);
+	for (int b = 0; b < 4; b++)
+		block[4 + b] = static_cast<unsigned char> ((indices >> (8 * b)) & 0xFF);
+}
+
+void encodeBC1 (const unsigned char * rgba, int width, int height, unsigned char * blocks) {
+	glm::vec3 texels[16];
+	for (int by = 0; by < height; by += 4)
+		for (int bx = 0; bx < width; bx += 4) {
+			for (int y = 0; y < 4; y++)
+				for (int x = 0; x < 4; x++) { // partial blocks repeat the last row and column
+					const unsigned char * texel = rgba + (size_t (std::min (by + y, height - 1)) * width
+					                                      + std::min (bx + x, width - 1)) * 4;
+					texels[y * 4 + x] = glm::vec3 (texel[0], texel[1], texel[2]);
+				}
+			encodeBlock (texels, blocks);
+			blocks += 8;
+		}
+}
+
+}
@@ -0,0 +1,18 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <cstddef>
+
+/// CPU encoder of BC1 (S3TC DXT1) textures: each block of 4x4 texels holds two RGB565 endpoints
+/// and a 2-bit index per texel into the four colors interpolated between them.
+namespace BlockCompression {
+
+/// Bytes of a BC1 image of the given size. Partial blocks at the right and bottom count as whole blocks.
+size_t bc1Size (int width, int height);
+
+/// Encodes an RGBA8 image (alpha ignored) into bc1Size (width, height) bytes of blocks, row of blocks after row of blocks
+void encodeBC1 (const unsigned char * rgba, int width, int height, unsigned char * blocks);
+
+}
+
+#endif // BLOCK_COMPRESSION_H
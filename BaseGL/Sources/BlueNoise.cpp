@@ -0,0 +1,178 @@
+#include "BlueNoise.h"
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include "Trace.h"
+
+using namespace std;
+
+static const char CACHE_MAGIC[4] = { 'B', 'N', 'Z', '1' };
+
+namespace BlueNoise {
+
+// Binary pattern of a tile, and the energy of each pixel: the sum over the set pixels of a Gaussian of their toroidal distance.
+// The tightest cluster is the set pixel of highest energy, the largest void the empty pixel of lowest energy.
+class Pattern {
+public:
+	Pattern (int size) : m_size (size), m_set (size * size, 0), m_energy (size * size, 0.0), m_filter (2 * size * size) {
+		const double sigma = 1.5; // the value of the paper, which spreads the points best
+		for (int y = 0; y < size; y++)
+			for (int x = 0; x < 2 * size; x++) {
+				int dx = std::abs (x - size) % size, dy = y;
+				dx = std::min (dx, size - dx);
+				dy = std::min (dy, size - dy);
+				m_filter[y * 2 * size + x] = std::exp (-(dx * dx + dy * dy) / (2 * sigma * sigma));
+			}
+	}
+
+	inline int count () const { return m_count; }
+	inline bool isSet (int pixel) const { return m_set[pixel]; }
+
+	void toggle (int pixel) {
+		const double sign = m_set[pixel] ? -1.0 : 1.0;
+		m_set[pixel] = !m_set[pixel];
+		m_count += m_set[pixel] ? 1 : -1;
+		const int px = pixel % m_size, py = pixel / m_size;
+		for (int y = 0; y < m_size; y++) {
+			const double * row = &m_filter[((y - py + m_size) % m_size) * 2 * m_size + m_size - px];
+			double * energy = &m_energy[y * m_size];
+			for (int x = 0; x < m_size; x++)
+				energy[x] += sign * row[x];
+		}
+	}
+
+	int tightestCluster () const {
+		int best = -1;
+		for (int p = 0; p < m_size * m_size; p++)
+			if (m_set[p] && (best < 0 || m_energy[p] > m_energy[best]))
+				best = p;
+		return best;
+	}
+
+	int largestVoid () const {
+		int best = -1;
+		for (int p = 0; p < m_size * m_size; p++)
+			if (!m_set[p] && (best < 0 || m_energy[p] < m_energy[best]))
+				best = p;
+		return best;
+	}
+
+private:
+	int m_size;
+	int m_count = 0;
+	std::vector<uint8_t> m_set;
+	std::vector<double> m_energy;
+	std::vector<double> m_filter; // Gaussian of the toroidal offset (x - size, y), over two periods in x
+};
+
+std::vector<uint32_t> voidAndCluster (int size, uint32_t seed) {
+	Trace::Scope scope ("void and cluster");
+	const int pixels = size * size;
+	Pattern pattern (size);
+	// Initial pattern: a tenth of the pixels, at random, then relaxed by moving the tightest cluster to the largest void
+	// until that moves the same pixel back
+	std::mt19937 random (seed);
+	while (pattern.count () < std::max (1, pixels / 10)) {
+		int pixel = static_cast<int> (random () % pixels);
+		if (!pattern.isSet (pixel))
+			pattern.toggle (pixel);
+	}
+	while (true) {
+		int cluster = pattern.tightestCluster ();
+		pattern.toggle (cluster);
+		int largest = pattern.largestVoid ();
+		pattern.toggle (largest);
+		if (largest == cluster)
+			break;
+	}
+
+	std::vector<uint32_t> ranks (pixels);
+	// The initial points get the lowest ranks, the tightest clusters first removed getting the highest of them
+	Pattern removed = pattern;
+	for (int rank = pattern.count () - 1; rank >= 0; rank--) {
+		int cluster = removed.tightestCluster ();
+		removed.toggle (cluster);
+		ranks[cluster] = rank;
+	}
+	// The other pixels, largest void first. Past half the pixels, the paper removes the tightest clusters of empty pixels
+	// instead, which are the same: the energy of the empty pixels is a constant minus the energy of the set ones.
+	for (int rank = pattern.count (); rank < pixels; rank++) {
+		int largest = pattern.largestVoid ();
+		pattern.toggle (largest);
+		ranks[largest] = rank;
+	}
+	return ranks;
+}
+
+static bool loadCache (const std::string & filename, PendingTile & tile) {
+	ifstream in (filename.c_str (), std::ios::binary);
+	if (!in)
+		return false;
+	char magic[4];
+	int32_t size = 0, channels = 0;
+	in.read (magic, 4);
+	in.read (reinterpret_cast<char *> (&size), sizeof (size));
+	in.read (reinterpret_cast<char *> (&channels), sizeof (channels));
+	if (!in || !std::equal (magic, magic + 4, CACHE_MAGIC) || size != tile.size || channels != tile.channels)
+		return false;
+	tile.ranks.resize (size * size * channels);
+	in.read (reinterpret_cast<char *> (tile.ranks.data ()), tile.ranks.size () * sizeof (uint16_t));
+	return static_cast<bool> (in);
+}
+
+static void saveCache (const std::string & filename, const PendingTile & tile) {
+	ofstream out (filename.c_str (), std::ios::binary);
+	if (!out) {
+		std::cout << " > Cannot write the blue noise cache " << filename << std::endl;
+		return;
+	}
+	int32_t size = tile.size, channels = tile.channels;
+	out.write (CACHE_MAGIC, 4);
+	out.write (reinterpret_cast<const char *> (&size), sizeof (size));
+	out.write (reinterpret_cast<const char *> (&channels), sizeof (channels));
+	out.write (reinterpret_cast<const char *> (tile.ranks.data ()), tile.ranks.size () * sizeof (uint16_t));
+}
+
+PendingTile startTile (ThreadPool & pool, int size, int channels, const std::string & cache) {
+	if (size <= 0 || size > 256 || channels <= 0)
+		throw std::runtime_error ("[BlueNoise][startTile] Invalid tile size");
+	PendingTile tile;
+	tile.size = size;
+	tile.channels = channels;
+	tile.cache = cache;
+	if (loadCache (cache, tile))
+		return tile;
+	tile.ranks.clear ();
+	for (int channel = 0; channel < channels; channel++)
+		tile.pending.push_back (pool.submit ([size, channel] { return voidAndCluster (size, channel + 1); }));
+	return tile;
+}
+
+std::vector<uint16_t> finishTile (PendingTile & tile) {
+	if (tile.pending.empty ()) {
+		std::cout << " > Blue noise " << tile.size << "x" << tile.size << " loaded from " << tile.cache << std::endl;
+		return tile.ranks;
+	}
+	auto start = std::chrono::steady_clock::now ();
+	const int pixels = tile.size * tile.size;
+	tile.ranks.resize (pixels * tile.channels);
+	for (int channel = 0; channel < tile.channels; channel++) {
+		std::vector<uint32_t> ranks = tile.pending[channel].get ();
+		for (int p = 0; p < pixels; p++)
+			tile.ranks[p * tile.channels + channel] = static_cast<uint16_t> (ranks[p]);
+	}
+	tile.pending.clear ();
+	saveCache (tile.cache, tile);
+	std::chrono::duration<double, std::milli> waited = std::chrono::steady_clock::now () - start;
+	std::cout << " > Blue noise " << tile.size << "x" << tile.size << " (" << tile.channels << " channels) computed, waited "
+			  << waited.count () << " ms" << std::endl;
+	return tile.ranks;
+}
+
+}
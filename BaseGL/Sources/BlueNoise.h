@@ -0,0 +1,37 @@
+#ifndef BLUE_NOISE_H
+#define BLUE_NOISE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <future>
+
+#include "ThreadPool.h"
+
+/// Blue-noise tiles built with the void-and-cluster method (Ulichney 1993). Each channel of a tile holds the rank of
+/// every pixel in the order in which the method fills the tile: thresholding the ranks at any level gives a pattern whose
+/// points are evenly spread, with no low frequency, so that the noise it drives is easy to filter out. Tiles are toroidal.
+namespace BlueNoise {
+
+/// Rank of each pixel of a size x size tile, in [0, size^2), row by row. The seed picks the initial pattern.
+std::vector<uint32_t> voidAndCluster (int size, uint32_t seed);
+
+/// Tile whose channels are being computed on worker threads, one task per channel, unless read from the cache
+struct PendingTile {
+	int size = 0;
+	int channels = 0;
+	std::string cache;
+	std::vector<uint16_t> ranks; // channels interleaved, once loaded
+	std::vector<std::future<std::vector<uint32_t>>> pending;
+};
+
+/// Starts loading a tile of independent channels (at most 256x256) from the cache file, or computing it on the pool if
+/// the file does not hold it
+PendingTile startTile (ThreadPool & pool, int size, int channels, const std::string & cache);
+
+/// Waits for the workers, and writes the cache file if the tile was computed. Returns the ranks, channels interleaved.
+std::vector<uint16_t> finishTile (PendingTile & tile);
+
+}
+
+#endif // BLUE_NOISE_H
@@ -7,13 +7,13 @@
 class Camera : public Transform {
 public:
 	inline float getFov () const { return m_fov; }
-	inline void setFoV (float f) { m_fov = f; }
+	inline void setFoV (float f) { m_fov = f; touch (); }
 	inline float getAspectRatio () const { return m_aspectRatio; }
-	inline void setAspectRatio (float a) { m_aspectRatio = a; }
+	inline void setAspectRatio (float a) { m_aspectRatio = a; touch (); }
 	inline float getNear () const { return m_near; }
-	inline void setNear (float n) { m_near = n; }
+	inline void setNear (float n) { m_near = n; touch (); }
 	inline float getFar () const { return m_far; }
-	inline void setFar (float n) { m_far = n; }
+	inline void setFar (float n) { m_far = n; touch (); }
 	
 	/**
 	 *  The view matrix is the inverse of the camera model matrix, 
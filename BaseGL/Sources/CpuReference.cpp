@@ -0,0 +1,741 @@
+#include "CpuReference.h"
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <iomanip>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_REFERENCE_SSE
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace CpuReference {
+
+// Pixels per packet, processed together
+static const int LANES = 4;
+// Side of the screen tiles handed to the workers, a multiple of LANES
+static const int TILE_SIZE = 64;
+// Vertices and triangles per task of the rasterizer
+static const int PRIMITIVE_CHUNK = 4096;
+
+// Clear value of the normal target (glClearColor)
+static const float NORMAL_CLEAR = 0.2f;
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Packets of LANES floats. Masks are packets too, all bits set where a comparison holds.
+
+#ifdef CPU_REFERENCE_SSE
+
+struct Packet {
+	__m128 v;
+	Packet () : v (_mm_setzero_ps ()) {}
+	Packet (float f) : v (_mm_set1_ps (f)) {}
+	explicit Packet (__m128 m) : v (m) {}
+};
+
+static inline Packet load (const float * p) { return Packet (_mm_loadu_ps (p)); }
+static inline void store (float * p, Packet a) { _mm_storeu_ps (p, a.v); }
+static inline Packet operator+ (Packet a, Packet b) { return Packet (_mm_add_ps (a.v, b.v)); }
+static inline Packet operator- (Packet a, Packet b) { return Packet (_mm_sub_ps (a.v, b.v)); }
+static inline Packet operator* (Packet a, Packet b) { return Packet (_mm_mul_ps (a.v, b.v)); }
+static inline Packet operator/ (Packet a, Packet b) { return Packet (_mm_div_ps (a.v, b.v)); }
+static inline Packet operator- (Packet a) { return Packet (_mm_xor_ps (a.v, _mm_set1_ps (-0.f))); }
+// As _mm_max_ps and _mm_min_ps, these return b where a is NaN
+static inline Packet max (Packet a, Packet b) { return Packet (_mm_max_ps (a.v, b.v)); }
+static inline Packet min (Packet a, Packet b) { return Packet (_mm_min_ps (a.v, b.v)); }
+static inline Packet sqrt (Packet a) { return Packet (_mm_sqrt_ps (a.v)); }
+static inline Packet abs (Packet a) { return Packet (_mm_andnot_ps (_mm_set1_ps (-0.f), a.v)); }
+static inline Packet operator< (Packet a, Packet b) { return Packet (_mm_cmplt_ps (a.v, b.v)); }
+static inline Packet operator>= (Packet a, Packet b) { return Packet (_mm_cmpge_ps (a.v, b.v)); }
+static inline Packet operator== (Packet a, Packet b) { return Packet (_mm_cmpeq_ps (a.v, b.v)); }
+static inline Packet operator!= (Packet a, Packet b) { return Packet (_mm_cmpneq_ps (a.v, b.v)); }
+static inline Packet operator| (Packet a, Packet b) { return Packet (_mm_or_ps (a.v, b.v)); }
+static inline Packet operator& (Packet a, Packet b) { return Packet (_mm_and_ps (a.v, b.v)); }
+static inline Packet select (Packet mask, Packet a, Packet b) {
+	return Packet (_mm_or_ps (_mm_and_ps (mask.v, a.v), _mm_andnot_ps (mask.v, b.v)));
+}
+static inline bool any (Packet mask) { return _mm_movemask_ps (mask.v) != 0; }
+
+// For |a| < 2^31
+static inline Packet floor (Packet a) {
+	__m128 t = _mm_cvtepi32_ps (_mm_cvttps_epi32 (a.v));
+	return Packet (_mm_sub_ps (t, _mm_and_ps (_mm_cmpgt_ps (t, a.v), _mm_set1_ps (1.f))));
+}
+
+// Truncated towards 0
+static inline void toInt (Packet a, int32_t * out) {
+	_mm_storeu_si128 (reinterpret_cast<__m128i *> (out), _mm_cvttps_epi32 (a.v));
+}
+
+// Polynomial of the Cephes library after the reduction to [-ln(2)/2, ln(2)/2], within 2 ulps
+static inline Packet exp (Packet x) {
+	x = min (max (x, -87.3f), 88.3f);
+	Packet n = floor (x * 1.44269504088896341f + 0.5f);
+	x = x - n * 0.693359375f + n * 2.12194440e-4f;
+	Packet y = ((((1.9875691500e-4f * x + 1.3981999507e-3f) * x + 8.3334519073e-3f) * x + 4.1665795894e-2f) * x
+				+ 1.6666665459e-1f) * x + 5.0000001201e-1f;
+	y = y * x * x + x + 1.f;
+	__m128i e = _mm_slli_epi32 (_mm_add_epi32 (_mm_cvttps_epi32 (n.v), _mm_set1_epi32 (127)), 23);
+	return y * Packet (_mm_castsi128_ps (e));
+}
+
+#else
+
+struct Packet {
+	float v[LANES];
+	Packet () : Packet (0.f) {}
+	Packet (float f) { for (float & x : v) x = f; }
+};
+
+template <class F>
+static inline Packet map (Packet a, Packet b, F f) {
+	Packet r;
+	for (int l = 0; l < LANES; l++)
+		r.v[l] = f (a.v[l], b.v[l]);
+	return r;
+}
+
+// Lanes of a mask
+static inline float maskOf (bool b) { return b ? 1.f : 0.f; }
+
+static inline Packet load (const float * p) { Packet r; std::copy (p, p + LANES, r.v); return r; }
+static inline void store (float * p, Packet a) { std::copy (a.v, a.v + LANES, p); }
+static inline Packet operator+ (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return x + y; }); }
+static inline Packet operator- (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return x - y; }); }
+static inline Packet operator* (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return x * y; }); }
+static inline Packet operator/ (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return x / y; }); }
+static inline Packet operator- (Packet a) { return map (a, a, [] (float x, float) { return -x; }); }
+// As the SSE version, these return b where a is NaN
+static inline Packet max (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return x > y ? x : y; }); }
+static inline Packet min (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return x < y ? x : y; }); }
+static inline Packet sqrt (Packet a) { return map (a, a, [] (float x, float) { return std::sqrt (x); }); }
+static inline Packet abs (Packet a) { return map (a, a, [] (float x, float) { return std::abs (x); }); }
+static inline Packet operator< (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return maskOf (x < y); }); }
+static inline Packet operator>= (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return maskOf (x >= y); }); }
+static inline Packet operator== (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return maskOf (x == y); }); }
+static inline Packet operator!= (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return maskOf (x != y); }); }
+static inline Packet operator| (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return maskOf (x != 0.f || y != 0.f); }); }
+static inline Packet operator& (Packet a, Packet b) { return map (a, b, [] (float x, float y) { return maskOf (x != 0.f && y != 0.f); }); }
+static inline Packet select (Packet mask, Packet a, Packet b) {
+	Packet r;
+	for (int l = 0; l < LANES; l++)
+		r.v[l] = mask.v[l] != 0.f ? a.v[l] : b.v[l];
+	return r;
+}
+static inline bool any (Packet mask) { return std::any_of (mask.v, mask.v + LANES, [] (float x) { return x != 0.f; }); }
+static inline Packet floor (Packet a) { return map (a, a, [] (float x, float) { return std::floor (x); }); }
+static inline void toInt (Packet a, int32_t * out) { for (int l = 0; l < LANES; l++) out[l] = static_cast<int32_t> (a.v[l]); }
+static inline Packet exp (Packet a) { return map (a, a, [] (float x, float) { return std::exp (x); }); }
+
+#endif
+
+static inline Packet clamp (Packet a, float low, float high) { return min (max (a, low), high); }
+
+// Power of the lanes, by squaring for the integer exponents of the shaders
+static Packet power (Packet a, float exponent) {
+	if (exponent >= 0.f && exponent <= 1024.f && exponent == std::floor (exponent)) {
+		Packet result (1.f);
+		for (int e = static_cast<int> (exponent); e > 0; e >>= 1, a = a * a)
+			if (e & 1)
+				result = result * a;
+		return result;
+	}
+	float lanes[LANES];
+	store (lanes, a);
+	for (float & x : lanes)
+		x = std::pow (x, exponent);
+	return load (lanes);
+}
+
+// Value stored by an 8-bit normalized target (NaN stored as 0), as read back by the next pass
+static inline Packet unorm8 (Packet a) {
+	return floor (clamp (a, 0.f, 1.f) * 255.f + 0.5f) * (1.f / 255.f);
+}
+
+struct Vector {
+	Packet x, y, z;
+	Vector () {}
+	Vector (Packet x, Packet y, Packet z) : x (x), y (y), z (z) {}
+	Vector (const glm::vec3 & v) : x (v.x), y (v.y), z (v.z) {}
+};
+
+static inline Vector operator+ (const Vector & a, const Vector & b) { return Vector (a.x + b.x, a.y + b.y, a.z + b.z); }
+static inline Vector operator- (const Vector & a, const Vector & b) { return Vector (a.x - b.x, a.y - b.y, a.z - b.z); }
+static inline Vector operator* (const Vector & a, Packet s) { return Vector (a.x * s, a.y * s, a.z * s); }
+static inline Packet dot (const Vector & a, const Vector & b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline Packet length (const Vector & a) { return sqrt (dot (a, a)); }
+static inline Vector normalize (const Vector & a) { return a * (Packet (1.f) / length (a)); }
+static inline Vector cross (const Vector & a, const Vector & b) {
+	return Vector (a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+static inline Vector select (Packet mask, const Vector & a, const Vector & b) {
+	return Vector (select (mask, a.x, b.x), select (mask, a.y, b.y), select (mask, a.z, b.z));
+}
+
+// Product of the matrix with (v, w), then the division by the last coordinate if divide
+static inline Vector transform (const glm::mat4 & m, const Vector & v, float w, bool divide) {
+	Vector r (m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z + m[3][0] * w,
+			  m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z + m[3][1] * w,
+			  m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z + m[3][2] * w);
+	if (!divide)
+		return r;
+	return r * (Packet (1.f) / (m[0][3] * v.x + m[1][3] * v.y + m[2][3] * v.z + m[3][3] * w));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+// Runs task (first, last) over [0, count) in chunks of the given size on the workers, and waits for all of them
+template <class F>
+static void parallelFor (ThreadPool & pool, int count, int chunk, F task) {
+	std::vector<std::future<void>> done;
+	for (int first = 0; first < count; first += chunk) {
+		const int last = std::min (count, first + chunk);
+		done.push_back (pool.submit ([&task, first, last] { task (first, last); }));
+	}
+	for (auto & d : done)
+		d.get ();
+}
+
+// Runs task (x0, x1, y0, y1) over the tiles of the screen, x1 rounded up to a multiple of LANES
+template <class F>
+static void parallelTiles (ThreadPool & pool, int width, int height, F task) {
+	const int columns = (width + TILE_SIZE - 1) / TILE_SIZE, rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+	parallelFor (pool, columns * rows, 1, [&] (int tile, int) {
+		const int x0 = (tile % columns) * TILE_SIZE, y0 = (tile / columns) * TILE_SIZE;
+		const int x1 = std::min (x0 + TILE_SIZE, (width + LANES - 1) / LANES * LANES);
+		task (x0, x1, y0, std::min (y0 + TILE_SIZE, height));
+	});
+}
+
+static glm::vec3 octDecode (glm::vec2 e) {
+	e = e * 2.f - 1.f;
+	glm::vec3 n (e, 1.f - std::abs (e.x) - std::abs (e.y));
+	if (n.z < 0.f)
+		n = glm::vec3 ((1.f - std::abs (n.y)) * (n.x >= 0.f ? 1.f : -1.f), (1.f - std::abs (n.x)) * (n.y >= 0.f ? 1.f : -1.f), n.z);
+	return glm::normalize (n);
+}
+
+static glm::vec2 octEncode (glm::vec3 n) {
+	n /= std::abs (n.x) + std::abs (n.y) + std::abs (n.z);
+	glm::vec2 e = n.z >= 0.f ? glm::vec2 (n)
+		: glm::vec2 ((1.f - std::abs (n.y)) * (n.x >= 0.f ? 1.f : -1.f), (1.f - std::abs (n.x)) * (n.y >= 0.f ? 1.f : -1.f));
+	return e * 0.5f + 0.5f;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// G-buffer
+
+GBuffer readGBuffer (GLuint depthTexture, GLuint normalTexture, int width, int height) {
+	GBuffer gbuffer;
+	gbuffer.width = width;
+	gbuffer.height = height;
+	gbuffer.depth.resize (size_t (width) * height);
+	gbuffer.normals.resize (size_t (width) * height);
+	glPixelStorei (GL_PACK_ALIGNMENT, 4);
+	glGetTextureImage (depthTexture, 0, GL_DEPTH_COMPONENT, GL_FLOAT, static_cast<GLsizei> (gbuffer.depth.size () * sizeof (float)),
+					   gbuffer.depth.data ());
+	glGetTextureImage (normalTexture, 0, GL_RG, GL_FLOAT, static_cast<GLsizei> (gbuffer.normals.size () * sizeof (glm::vec2)),
+					   gbuffer.normals.data ());
+	return gbuffer;
+}
+
+namespace {
+
+// Vertex of the rasterizer, in clip space
+struct ClipVertex {
+	glm::vec4 position;
+	glm::vec3 normal;
+};
+
+// Triangle in window coordinates (z being the depth buffer value), with what the perspective-correct interpolation needs
+struct ScreenTriangle {
+	glm::vec3 window[3];
+	float inverseW[3];
+	glm::vec3 normalOverW[3];
+	float area; // twice the signed area, positive for the front faces
+	int x0, y0, x1, y1; // pixels of the bounding box, inclusive
+};
+
+}
+
+// Part of the triangle in front of the near plane (z >= -w), as a fan of one or two triangles
+static int clipNear (const ClipVertex (&triangle)[3], ClipVertex (&polygon)[4]) {
+	int count = 0;
+	for (int i = 0; i < 3; i++) {
+		const ClipVertex & a = triangle[i], & b = triangle[(i + 1) % 3];
+		const float da = a.position.z + a.position.w, db = b.position.z + b.position.w;
+		if (da >= 0.f)
+			polygon[count++] = a;
+		if ((da >= 0.f) != (db >= 0.f)) {
+			const float t = da / (da - db);
+			polygon[count++] = { a.position + t * (b.position - a.position), a.normal + t * (b.normal - a.normal) };
+		}
+	}
+	return count;
+}
+
+// Whether an edge owns the pixel centers on it: its top and left edges, interior on the left of the edge, y up
+static inline bool topLeft (const glm::vec3 & a, const glm::vec3 & b) {
+	return b.y < a.y || (b.y == a.y && b.x < a.x);
+}
+
+static inline float edge (const glm::vec3 & a, const glm::vec3 & b, float x, float y) {
+	return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+}
+
+GBuffer rasterize (const Mesh & mesh, const glm::mat4 & modelViewMatrix, const glm::mat4 & projectionMatrix,
+				   int width, int height, ThreadPool & pool) {
+	// Vertex shader of geometry.vs
+	const std::vector<glm::vec3> & positions = mesh.vertexPositions (), & normals = mesh.vertexNormals ();
+	const glm::mat4 modelViewProjection = projectionMatrix * modelViewMatrix;
+	const glm::mat3 normalMatrix = glm::mat3 (glm::transpose (glm::inverse (modelViewMatrix)));
+	std::vector<ClipVertex> vertices (positions.size ());
+	parallelFor (pool, static_cast<int> (positions.size ()), PRIMITIVE_CHUNK, [&] (int first, int last) {
+		for (int v = first; v < last; v++)
+			vertices[v] = { modelViewProjection * glm::vec4 (positions[v], 1.f), normalMatrix * normals[v] };
+	});
+
+	// Primitive assembly: clipping, viewport transform, culling. Chunks keep the order of the triangles, which
+	// decides between equal depths.
+	const std::vector<glm::uvec3> & indices = mesh.triangleIndices ();
+	const int triangleCount = static_cast<int> (indices.size ());
+	std::vector<std::vector<ScreenTriangle>> chunks ((triangleCount + PRIMITIVE_CHUNK - 1) / PRIMITIVE_CHUNK);
+	parallelFor (pool, triangleCount, PRIMITIVE_CHUNK, [&] (int first, int last) {
+		std::vector<ScreenTriangle> & screen = chunks[first / PRIMITIVE_CHUNK];
+		for (int t = first; t < last; t++) {
+			const ClipVertex triangle[3] = { vertices[indices[t][0]], vertices[indices[t][1]], vertices[indices[t][2]] };
+			ClipVertex polygon[4];
+			const int count = clipNear (triangle, polygon);
+			for (int fan = 1; fan + 1 < count; fan++) {
+				ScreenTriangle s;
+				const ClipVertex * corners[3] = { &polygon[0], &polygon[fan], &polygon[fan + 1] };
+				for (int i = 0; i < 3; i++) {
+					const glm::vec4 & p = corners[i]->position;
+					s.inverseW[i] = 1.f / p.w;
+					const glm::vec3 ndc = glm::vec3 (p) * s.inverseW[i];
+					s.window[i] = glm::vec3 ((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+					s.normalOverW[i] = corners[i]->normal * s.inverseW[i];
+				}
+				s.area = edge (s.window[0], s.window[1], s.window[2].x, s.window[2].y);
+				if (!(s.area > 0.f)) // back face, or degenerate
+					continue;
+				const glm::vec3 lo = glm::min (s.window[0], glm::min (s.window[1], s.window[2]));
+				const glm::vec3 hi = glm::max (s.window[0], glm::max (s.window[1], s.window[2]));
+				// Pixel centers x + 0.5 in [lo, hi]
+				s.x0 = static_cast<int> (std::max (0.f, std::ceil (lo.x - 0.5f)));
+				s.y0 = static_cast<int> (std::max (0.f, std::ceil (lo.y - 0.5f)));
+				s.x1 = static_cast<int> (std::min (width - 1.f, std::floor (hi.x - 0.5f)));
+				s.y1 = static_cast<int> (std::min (height - 1.f, std::floor (hi.y - 0.5f)));
+				if (s.x0 <= s.x1 && s.y0 <= s.y1)
+					screen.push_back (s);
+			}
+		}
+	});
+
+	// Binning, then the tiles in parallel
+	const int columns = (width + TILE_SIZE - 1) / TILE_SIZE, rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+	std::vector<std::vector<const ScreenTriangle *>> bins (columns * rows);
+	for (const auto & chunk : chunks)
+		for (const ScreenTriangle & s : chunk)
+			for (int ty = s.y0 / TILE_SIZE; ty <= s.y1 / TILE_SIZE; ty++)
+				for (int tx = s.x0 / TILE_SIZE; tx <= s.x1 / TILE_SIZE; tx++)
+					bins[ty * columns + tx].push_back (&s);
+
+	GBuffer gbuffer;
+	gbuffer.width = width;
+	gbuffer.height = height;
+	gbuffer.depth.assign (size_t (width) * height, 1.f);
+	const float normalClear = std::floor (NORMAL_CLEAR * 65535.f + 0.5f) / 65535.f;
+	gbuffer.normals.assign (size_t (width) * height, glm::vec2 (normalClear));
+	const float DEPTH_MAX = 16777215.f; // 24-bit depth buffer
+	parallelFor (pool, columns * rows, 1, [&] (int tile, int) {
+		const int tx0 = (tile % columns) * TILE_SIZE, ty0 = (tile / columns) * TILE_SIZE;
+		const int tx1 = std::min (tx0 + TILE_SIZE, width) - 1, ty1 = std::min (ty0 + TILE_SIZE, height) - 1;
+		for (const ScreenTriangle * s : bins[tile]) {
+			const glm::vec3 & a = s->window[0], & b = s->window[1], & c = s->window[2];
+			const bool owns[3] = { topLeft (b, c), topLeft (c, a), topLeft (a, b) };
+			for (int y = std::max (s->y0, ty0); y <= std::min (s->y1, ty1); y++)
+				for (int x = std::max (s->x0, tx0); x <= std::min (s->x1, tx1); x++) {
+					const float px = x + 0.5f, py = y + 0.5f;
+					const float w[3] = { edge (b, c, px, py), edge (c, a, px, py), edge (a, b, px, py) };
+					if (w[0] < 0.f || w[1] < 0.f || w[2] < 0.f || (w[0] == 0.f && !owns[0]) || (w[1] == 0.f && !owns[1])
+						|| (w[2] == 0.f && !owns[2]))
+						continue;
+					const float l[3] = { w[0] / s->area, w[1] / s->area, w[2] / s->area };
+					// Depth linear in screen space, clipped by the far plane
+					const float z = l[0] * a.z + l[1] * b.z + l[2] * c.z;
+					if (z < 0.f || z > 1.f)
+						continue;
+					const float depth = std::floor (z * DEPTH_MAX + 0.5f) / DEPTH_MAX;
+					const size_t p = size_t (y) * width + x;
+					if (!(depth < gbuffer.depth[p]))
+						continue;
+					gbuffer.depth[p] = depth;
+					const glm::vec3 n = (l[0] * s->normalOverW[0] + l[1] * s->normalOverW[1] + l[2] * s->normalOverW[2])
+						/ (l[0] * s->inverseW[0] + l[1] * s->inverseW[1] + l[2] * s->inverseW[2]);
+					gbuffer.normals[p] = glm::floor (octEncode (glm::normalize (n)) * 65535.f + 0.5f) / 65535.f;
+				}
+		}
+	});
+	return gbuffer;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Passes
+
+namespace {
+
+// RGB image, one plane per channel
+struct Image {
+	std::vector<float> channels[3];
+
+	void resize (size_t size) {
+		for (auto & c : channels)
+			c.assign (size, 0.f);
+	}
+};
+
+// Planes of the passes, their rows padded to a multiple of LANES. The G-buffer is decoded once into what the shaders
+// compute from each texel they read, so that the samples only gather.
+struct Frame {
+	int width, height, stride;
+	std::vector<float> depth; // 1 where nothing was drawn, and on the padding
+	std::vector<float> viewZ; // viewDepth () of direct.fs
+	std::vector<float> position[3]; // viewPosition () at the pixel center
+	std::vector<float> normal[3];
+	std::vector<float> rotation[2]; // cosine and sine of the kernel rotation
+	Image lighting, direct, indirect, blurred, directBlur, indirectBlur;
+};
+
+}
+
+// Pixel indices of the packets of texture coordinates, nearest texel clamped to the edges
+static inline void texelIndices (const Frame & frame, Packet u, Packet v, int32_t * indices) {
+	int32_t xs[LANES], ys[LANES];
+	// Clamped before the floor too, which only holds on the range of 32-bit integers
+	toInt (clamp (floor (clamp (u * float (frame.width), -1.f, float (frame.width))), 0.f, float (frame.width - 1)), xs);
+	toInt (clamp (floor (clamp (v * float (frame.height), -1.f, float (frame.height))), 0.f, float (frame.height - 1)), ys);
+	for (int l = 0; l < LANES; l++)
+		indices[l] = ys[l] * frame.stride + xs[l];
+}
+
+static inline Packet gather (const std::vector<float> & plane, const int32_t * indices) {
+	float lanes[LANES];
+	for (int l = 0; l < LANES; l++)
+		lanes[l] = plane[indices[l]];
+	return load (lanes);
+}
+
+static inline Vector gather (const std::vector<float> (&planes)[3], const int32_t * indices) {
+	return Vector (gather (planes[0], indices), gather (planes[1], indices), gather (planes[2], indices));
+}
+
+static inline Vector loadVector (const std::vector<float> (&planes)[3], size_t p) {
+	return Vector (load (&planes[0][p]), load (&planes[1][p]), load (&planes[2][p]));
+}
+
+static inline void storeColor (Image & image, size_t p, const Vector & color) {
+	store (&image.channels[0][p], color.x);
+	store (&image.channels[1][p], color.y);
+	store (&image.channels[2][p], color.z);
+}
+
+static void decode (Frame & frame, const GBuffer & gbuffer, const Settings & settings, ThreadPool & pool) {
+	const int width = gbuffer.width, height = gbuffer.height;
+	const glm::mat4 & P = settings.projectionMatrix;
+	const glm::mat4 inverseProjection = glm::inverse (P);
+	// textureSize (gNormal) / textureSize (texNoise) is an integer division
+	const int noiseSize = std::max (settings.noiseSize, 1);
+	const glm::vec2 noiseScale (width / noiseSize, height / noiseSize);
+	parallelTiles (pool, width, height, [&] (int x0, int x1, int y0, int y1) {
+		for (int y = y0; y < y1; y++)
+			for (int x = x0; x < x1; x++) {
+				const size_t p = size_t (y) * frame.stride + x;
+				if (x >= width)
+					continue; // padding, left as background
+				const size_t g = size_t (y) * width + x;
+				const glm::vec2 uv ((x + 0.5f) / width, (y + 0.5f) / height);
+				const float depth = gbuffer.depth[g];
+				frame.depth[p] = depth;
+				frame.viewZ[p] = -P[3][2] / (depth * 2.f - 1.f + P[2][2]);
+				const glm::vec4 view = inverseProjection * glm::vec4 (glm::vec3 (uv, depth) * 2.f - 1.f, 1.f);
+				const glm::vec3 normal = octDecode (gbuffer.normals[g]);
+				for (int c = 0; c < 3; c++) {
+					frame.position[c][p] = view[c] / view.w;
+					frame.normal[c][p] = normal[c];
+				}
+				// Nearest texel of the repeated noise tile
+				const glm::vec2 noiseUv = uv * noiseScale;
+				const int nx = ((static_cast<int> (std::floor (noiseUv.x * noiseSize)) % noiseSize) + noiseSize) % noiseSize;
+				const int ny = ((static_cast<int> (std::floor (noiseUv.y * noiseSize)) % noiseSize) + noiseSize) % noiseSize;
+				const float noise = settings.noise.empty () ? 0.f : settings.noise[ny * noiseSize + nx];
+				const float angle = 6.2831853f * (noise - std::floor (noise));
+				frame.rotation[0][p] = std::cos (angle);
+				frame.rotation[1][p] = std::sin (angle);
+			}
+	});
+}
+
+// lighting.fs
+static void lighting (Frame & frame, const Settings & settings, ThreadPool & pool) {
+	const Vector lightPosition (settings.lightPosition), lightColor (settings.lightColor);
+	parallelTiles (pool, frame.width, frame.height, [&] (int x0, int x1, int y0, int y1) {
+		for (int y = y0; y < y1; y++)
+			for (int x = x0; x < x1; x += LANES) {
+				const size_t p = size_t (y) * frame.stride + x;
+				const Packet geometry = load (&frame.depth[p]) != 1.f;
+				if (!any (geometry))
+					continue;
+				const Vector position = loadVector (frame.position, p), normal = loadVector (frame.normal, p);
+				const Vector wo = normalize (Vector () - position);
+				const Vector wi = normalize (lightPosition - position);
+				const Vector wh = normalize (wi + wo);
+				const Vector diffuse = lightColor * (max (dot (normal, wi), 0.f) * 0.95f);
+				const Vector specular = lightColor * (0.3f * power (max (dot (normal, wh), 0.f), 50.f));
+				const Packet distance = length (lightPosition - position);
+				const Packet attenuation = Packet (1.f) / (1.f + settings.lightLinear * distance
+														   + settings.lightQuadratic * distance * distance);
+				const Vector color = (diffuse + specular) * attenuation;
+				storeColor (frame.lighting, p, select (geometry, Vector (unorm8 (color.x), unorm8 (color.y), unorm8 (color.z)),
+													   Vector ()));
+			}
+	});
+}
+
+// Kernel frame of direct.fs and indirect.fs
+static inline void tangentFrame (const Frame & frame, size_t p, const Vector & normal, Vector & tangent, Vector & bitangent) {
+	const Vector random (load (&frame.rotation[0][p]), load (&frame.rotation[1][p]), 0.f);
+	tangent = normalize (random - normal * dot (random, normal));
+	bitangent = cross (normal, tangent);
+}
+
+// direct.fs, with the sky lookup through the spherical harmonics (SKY_SH)
+static void direct (Frame & frame, const Settings & settings, ThreadPool & pool) {
+	const glm::mat4 & P = settings.projectionMatrix;
+	const glm::mat4 inverseView = glm::inverse (settings.viewMatrix);
+	std::vector<glm::vec3> sh (9, glm::vec3 (0.f));
+	if (settings.sky)
+		sh = settings.sky->sh ();
+	const float kernelSize = static_cast<float> (settings.kernel.size ());
+	parallelTiles (pool, frame.width, frame.height, [&] (int x0, int x1, int y0, int y1) {
+		for (int y = y0; y < y1; y++)
+			for (int x = x0; x < x1; x += LANES) {
+				const size_t p = size_t (y) * frame.stride + x;
+				const Packet geometry = load (&frame.depth[p]) != 1.f;
+				if (!any (geometry))
+					continue;
+				const Vector fragPos = loadVector (frame.position, p), normal = loadVector (frame.normal, p);
+				Vector tangent, bitangent;
+				tangentFrame (frame, p, normal, tangent, bitangent);
+				Vector light (0.f, 0.f, 0.f);
+				for (const glm::vec3 & sample : settings.kernel) {
+					const Vector samplePos = fragPos + (tangent * sample.x + bitangent * sample.y + normal * sample.z) * settings.radius;
+					const Vector offset = transform (P, samplePos, 1.f, true);
+					int32_t indices[LANES];
+					texelIndices (frame, offset.x * 0.5f + 0.5f, offset.y * 0.5f + 0.5f, indices);
+					const Packet visible = (gather (frame.viewZ, indices) < samplePos.z) | (gather (frame.depth, indices) == 1.f);
+					if (!any (visible))
+						continue;
+					const Vector toSample = samplePos - fragPos;
+					const Vector d = normalize (transform (inverseView, toSample, 0.f, false));
+					Vector c = Vector (sh[0]) * 0.282095f
+						+ (Vector (sh[1]) * d.y + Vector (sh[2]) * d.z + Vector (sh[3]) * d.x) * 0.488603f
+						+ (Vector (sh[4]) * (d.x * d.y) + Vector (sh[5]) * (d.y * d.z) + Vector (sh[7]) * (d.x * d.z)) * 1.092548f
+						+ Vector (sh[6]) * (0.315392f * (3.f * d.z * d.z - 1.f))
+						+ Vector (sh[8]) * (0.546274f * (d.x * d.x - d.y * d.y));
+					c = Vector (max (c.x, 0.f), max (c.y, 0.f), max (c.z, 0.f));
+					const Packet weight = settings.cosineKernel ? Packet (0.5f) : dot (normal, normalize (toSample));
+					light = light + select (visible, c * weight, Vector ());
+				}
+				light = light * (1.f / kernelSize);
+				storeColor (frame.direct, p, select (geometry, Vector (unorm8 (light.x), unorm8 (light.y), unorm8 (light.z)),
+													 Vector ()));
+			}
+	});
+}
+
+// indirect.fs
+static void indirect (Frame & frame, const Settings & settings, ThreadPool & pool) {
+	const glm::mat4 & P = settings.projectionMatrix;
+	const glm::mat4 inverseProjection = glm::inverse (P);
+	const float kernelSize = static_cast<float> (settings.kernel.size ());
+	parallelTiles (pool, frame.width, frame.height, [&] (int x0, int x1, int y0, int y1) {
+		for (int y = y0; y < y1; y++)
+			for (int x = x0; x < x1; x += LANES) {
+				const size_t p = size_t (y) * frame.stride + x;
+				const Packet geometry = load (&frame.depth[p]) != 1.f;
+				if (!any (geometry))
+					continue;
+				const Vector fragPos = loadVector (frame.position, p), normal = loadVector (frame.normal, p);
+				Vector tangent, bitangent;
+				tangentFrame (frame, p, normal, tangent, bitangent);
+				Vector light (0.f, 0.f, 0.f);
+				for (const glm::vec3 & sample : settings.kernel) {
+					const Vector samplePos = fragPos + (tangent * sample.x + bitangent * sample.y + normal * sample.z) * settings.radius;
+					const Vector offset = transform (P, samplePos, 1.f, true);
+					const Packet u = offset.x * 0.5f + 0.5f, v = offset.y * 0.5f + 0.5f;
+					int32_t indices[LANES];
+					texelIndices (frame, u, v, indices);
+					// viewPosition () at the sample coordinates, not at the texel center
+					const Packet depth = gather (frame.depth, indices);
+					const Vector samplePosition = transform (inverseProjection, Vector (u * 2.f - 1.f, v * 2.f - 1.f, depth * 2.f - 1.f),
+															 1.f, true);
+					const Packet lit = samplePosition.z >= samplePos.z;
+					if (!any (lit))
+						continue;
+					const Vector sampleNormal = gather (frame.normal, indices);
+					const Vector sampleColor = gather (frame.lighting.channels, indices);
+					const Packet cosine = max (dot (sampleNormal, normalize (fragPos - samplePosition)), 0.f);
+					light = light + select (lit, sampleColor * cosine, Vector ());
+				}
+				light = light * (20.f / kernelSize);
+				storeColor (frame.indirect, p, select (geometry, Vector (unorm8 (light.x), unorm8 (light.y), unorm8 (light.z)),
+													   Vector ()));
+			}
+	});
+}
+
+// One pass of blur.cs over each line of the screen along the direction: the line is copied with an apron of radius
+// texels on each side (clamped to the edges), as into the shared memory of the shader, and filtered a packet at a time
+static void blurPass (const Frame & frame, const Image & source, Image & destination, bool vertical, const Settings & settings,
+					  ThreadPool & pool) {
+	const int radius = settings.blurRadius;
+	const int length = vertical ? frame.height : frame.width, lines = vertical ? frame.width : frame.height;
+	const int padded = (length + LANES - 1) / LANES * LANES;
+	const float spatial = -0.5f / (settings.spatialSigma * settings.spatialSigma);
+	const size_t step = vertical ? frame.stride : 1, across = vertical ? 1 : frame.stride;
+	parallelFor (pool, lines, TILE_SIZE, [&] (int first, int last) {
+		const int cached = padded + 2 * radius;
+		std::vector<float> color[3], depth (cached), normal[3];
+		for (int c = 0; c < 3; c++) {
+			color[c].resize (cached);
+			normal[c].resize (cached);
+		}
+		float out[3][LANES];
+		for (int line = first; line < last; line++) {
+			const size_t origin = line * across;
+			for (int i = 0; i < cached; i++) {
+				const size_t texel = origin + std::max (0, std::min (i - radius, length - 1)) * step;
+				const float d = frame.depth[texel];
+				depth[i] = d == 1.f ? -1.f : -frame.viewZ[texel]; // -1: background
+				for (int c = 0; c < 3; c++) {
+					color[c][i] = source.channels[c][texel];
+					normal[c][i] = frame.normal[c][texel];
+				}
+			}
+			for (int x = 0; x < length; x += LANES) {
+				const int center = x + radius;
+				const Packet centerDepth = load (&depth[center]);
+				const Vector centerColor = loadVector (color, center), centerNormal = loadVector (normal, center);
+				Vector sum (0.f, 0.f, 0.f);
+				Packet total (0.f);
+				if (any (centerDepth >= 0.f))
+					for (int k = -radius; k <= radius; k++) {
+						const int i = center + k;
+						const Packet tapDepth = load (&depth[i]);
+						const Packet dz = (tapDepth - centerDepth) / (settings.depthSigma * centerDepth);
+						const Packet w = exp (spatial * float (k * k) - dz * dz)
+							* power (max (dot (centerNormal, loadVector (normal, i)), 0.f), settings.normalPower);
+						const Packet weight = select (tapDepth >= 0.f, w, 0.f);
+						sum = sum + loadVector (color, i) * weight;
+						total = total + weight;
+					}
+				const Packet filtered = (centerDepth >= 0.f) & (Packet (0.f) < total);
+				const Vector result = select (filtered, sum * (Packet (1.f) / total), centerColor);
+				store (out[0], unorm8 (result.x));
+				store (out[1], unorm8 (result.y));
+				store (out[2], unorm8 (result.z));
+				for (int l = 0; l < LANES && x + l < length; l++)
+					for (int c = 0; c < 3; c++)
+						destination.channels[c][origin + (x + l) * step] = out[c][l];
+			}
+		}
+	});
+}
+
+// The MODE 8 view of composite.fs
+static void composite (const Frame & frame, const Settings & settings, std::vector<unsigned char> & image, ThreadPool & pool) {
+	const glm::mat4 inverseViewProjection = glm::inverse (settings.projectionMatrix * glm::mat4 (glm::mat3 (settings.viewMatrix)));
+	const int width = frame.width, height = frame.height;
+	parallelTiles (pool, width, height, [&] (int x0, int x1, int y0, int y1) {
+		for (int y = y0; y < y1; y++)
+			for (int x = x0; x < std::min (x1, width); x++) {
+				const size_t p = size_t (y) * frame.stride + x;
+				glm::vec3 color (0.f);
+				if (frame.depth[p] != 1.f)
+					for (int c = 0; c < 3; c++)
+						color[c] = frame.lighting.channels[c][p] + frame.directBlur.channels[c][p] + frame.indirectBlur.channels[c][p];
+				else if (settings.sky) {
+					const glm::vec2 uv ((x + 0.5f) / width, (y + 0.5f) / height);
+					const glm::vec4 direction = inverseViewProjection * glm::vec4 (uv * 2.f - 1.f, 1.f, 1.f);
+					color = settings.sky->lookup (glm::vec3 (direction) / direction.w);
+				}
+				unsigned char * pixel = &image[(size_t (y) * width + x) * 4];
+				for (int c = 0; c < 3; c++)
+					pixel[c] = static_cast<unsigned char> (std::floor (std::max (0.f, std::min (color[c], 1.f)) * 255.f + 0.5f));
+				pixel[3] = 255;
+			}
+	});
+}
+
+std::vector<unsigned char> render (const GBuffer & gbuffer, const Settings & settings, ThreadPool & pool,
+								   std::vector<Timing> * timings) {
+	Frame frame;
+	frame.width = gbuffer.width;
+	frame.height = gbuffer.height;
+	frame.stride = (gbuffer.width + LANES - 1) / LANES * LANES;
+	const size_t size = size_t (frame.stride) * frame.height;
+	frame.depth.assign (size, 1.f);
+	frame.viewZ.assign (size, 0.f);
+	for (int c = 0; c < 3; c++) {
+		frame.position[c].assign (size, 0.f);
+		frame.normal[c].assign (size, 0.f);
+	}
+	for (auto & r : frame.rotation)
+		r.assign (size, 0.f);
+	for (Image * image : { &frame.lighting, &frame.direct, &frame.indirect, &frame.blurred, &frame.directBlur, &frame.indirectBlur })
+		image->resize (size);
+	std::vector<unsigned char> image (size_t (gbuffer.width) * gbuffer.height * 4);
+
+	auto timed = [&] (const char * name, const std::function<void ()> & pass) {
+		const auto start = std::chrono::steady_clock::now ();
+		pass ();
+		if (timings)
+			timings->push_back ({ name, std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count () });
+	};
+	timed ("decode", [&] { decode (frame, gbuffer, settings, pool); });
+	timed ("lighting", [&] { lighting (frame, settings, pool); });
+	timed ("direct", [&] { direct (frame, settings, pool); });
+	timed ("indirect", [&] { indirect (frame, settings, pool); });
+	timed ("blur", [&] {
+		blurPass (frame, frame.direct, frame.blurred, false, settings, pool);
+		blurPass (frame, frame.blurred, frame.directBlur, true, settings, pool);
+		blurPass (frame, frame.indirect, frame.blurred, false, settings, pool);
+		blurPass (frame, frame.blurred, frame.indirectBlur, true, settings, pool);
+	});
+	timed ("composite", [&] { composite (frame, settings, image, pool); });
+	return image;
+}
+
+void printTimings (std::ostream & out, const std::vector<Timing> & timings, int width, int height) {
+	const double megapixels = width * double (height) * 1e-6;
+	double total = 0.0;
+	std::ios::fmtflags flags = out.flags ();
+	std::streamsize precision = out.precision ();
+	out << std::fixed << std::setprecision (2);
+	for (const Timing & timing : timings) {
+		out << "    " << timing.name << ": " << timing.milliseconds << " ms, " << megapixels / (timing.milliseconds * 1e-3) << " MP/s" << std::endl;
+		total += timing.milliseconds;
+	}
+	out << "    total: " << total << " ms, " << megapixels / (total * 1e-3) << " MP/s" << std::endl;
+	out.flags (flags);
+	out.precision (precision);
+}
+
+}
@@ -0,0 +1,79 @@
+#ifndef CPU_REFERENCE_H
+#define CPU_REFERENCE_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "Environment.h"
+#include "ThreadPool.h"
+
+/// The SSDO pipeline on the CPU, as a reference that depends on no GPU driver: the passes after the geometry pass, mirroring
+/// lighting.fs, direct.fs, indirect.fs, blur.cs and the final view of composite.fs, down to the 8-bit render targets between
+/// them. The direct light sees the sky through its spherical harmonics projection (the SKY_SH lookup of direct.fs), and the
+/// background through its finest prefiltered level. The passes run on tiles (lines for the blur) spread over the workers,
+/// four pixels at a time in SSE registers where available.
+namespace CpuReference {
+
+/// G-buffer as the geometry pass leaves it, its rows from the bottom: the depth buffer values in [0, 1] (1 where nothing
+/// was drawn), and the octahedral normals remapped to [0, 1]
+struct GBuffer {
+	int width = 0;
+	int height = 0;
+	std::vector<float> depth;
+	std::vector<glm::vec2> normals;
+};
+
+/// Reads back the G-buffer rendered by the GPU. A valid OpenGL context must be active.
+GBuffer readGBuffer (GLuint depthTexture, GLuint normalTexture, int width, int height);
+
+/// Renders the G-buffer of the mesh as the geometry pass does (near plane clipping, back faces culled, depth test,
+/// depth and normals stored at the precision of their targets), on tiles of the screen spread over the workers
+GBuffer rasterize (const Mesh & mesh, const glm::mat4 & modelViewMatrix, const glm::mat4 & projectionMatrix,
+				   int width, int height, ThreadPool & pool);
+
+/// Uniforms of the passes
+struct Settings {
+	glm::mat4 projectionMatrix = glm::mat4 (1.f);
+	glm::mat4 viewMatrix = glm::mat4 (1.f);
+
+	// Point light of the Phong shading, in view space
+	glm::vec3 lightPosition = glm::vec3 (0.f);
+	glm::vec3 lightColor = glm::vec3 (1.f);
+	float lightLinear = 0.f;
+	float lightQuadratic = 0.f;
+
+	std::vector<glm::vec3> kernel; // SSDO samples, in the tangent frame
+	bool cosineKernel = false;
+	float radius = 1.f;
+	int noiseSize = 0;
+	std::vector<float> noise; // rotation of the kernel per pixel of the tile, in [0, 1), as sampled from its texture
+
+	const Environment * sky = nullptr; // black if null
+
+	int blurRadius = 4;
+	float spatialSigma = 2.f;
+	float depthSigma = 0.1f;
+	float normalPower = 16.f;
+};
+
+/// Wall-clock time of a pass
+struct Timing {
+	std::string name;
+	double milliseconds;
+};
+
+/// Final image (RGBA, 8 bits per channel, rows from the bottom) of the G-buffer. The time of each pass is appended to
+/// the timings if given: decoding the G-buffer, then lighting, direct, indirect, blur and composite.
+std::vector<unsigned char> render (const GBuffer & gbuffer, const Settings & settings, ThreadPool & pool,
+								   std::vector<Timing> * timings = nullptr);
+
+/// Prints the time and the throughput, in megapixels per second, of each pass and of their sum
+void printTimings (std::ostream & out, const std::vector<Timing> & timings, int width, int height);
+
+}
+
+#endif // CPU_REFERENCE_H
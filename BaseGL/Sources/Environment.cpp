@@ -0,0 +1,282 @@
+#include "Environment.h"
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <sys/stat.h>
+#include <glm/gtc/constants.hpp>
+
+#include "stb_image.h"
+#include "Trace.h"
+
+using namespace std;
+
+static const char CACHE_MAGIC[4] = { 'E', 'N', 'V', '1' };
+
+// Direction through the center of texel (x, y) of a face, following the OpenGL cube map layout (first row at t = -1)
+static glm::vec3 texelDirection (int face, int x, int y, int size) {
+	float s = 2.f * (x + .5f) / size - 1.f;
+	float t = 2.f * (y + .5f) / size - 1.f;
+	switch (face) {
+	case 0: return glm::vec3 (1.f, -t, -s);
+	case 1: return glm::vec3 (-1.f, -t, s);
+	case 2: return glm::vec3 (s, 1.f, t);
+	case 3: return glm::vec3 (s, -1.f, -t);
+	case 4: return glm::vec3 (s, -t, 1.f);
+	default: return glm::vec3 (-s, -t, -1.f);
+	}
+}
+
+// Real spherical harmonics basis up to band 2, for a unit direction
+static void shBasis (const glm::vec3 & d, float * y) {
+	y[0] = 0.282095f;
+	y[1] = 0.488603f * d.y;
+	y[2] = 0.488603f * d.z;
+	y[3] = 0.488603f * d.x;
+	y[4] = 1.092548f * d.x * d.y;
+	y[5] = 1.092548f * d.y * d.z;
+	y[6] = 0.315392f * (3.f * d.z * d.z - 1.f);
+	y[7] = 1.092548f * d.x * d.z;
+	y[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+Environment::Environment (ThreadPool & pool, const std::vector<std::string> & faces) {
+	Trace::Scope scope ("environment");
+	if (faces.size () != 6)
+		throw std::runtime_error ("[Environment][Environment] A cube map has 6 faces");
+	auto start = std::chrono::steady_clock::now ();
+	const std::string cache = faces[0] + ".env";
+	bool cached = loadCache (cache, faces);
+	if (!cached) {
+		compute (pool, faces);
+		saveCache (cache, faces);
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now () - start;
+	std::cout << " > Environment " << m_size << "x" << m_size << ", " << levels () << " levels, "
+			  << (cached ? "loaded from " + cache : "computed") << " in " << elapsed.count () << " ms" << std::endl;
+}
+
+Environment::~Environment () {
+	if (m_id)
+		glDeleteTextures (1, &m_id);
+}
+
+size_t Environment::gpuBytes () const {
+	size_t bytes = 0;
+	for (const auto & level : m_levels)
+		bytes += level.size () * 2; // half floats
+	return bytes;
+}
+
+glm::vec3 Environment::radiance (const glm::vec3 & direction) const {
+	float y[SH_COEFFICIENTS];
+	shBasis (direction, y);
+	glm::vec3 result (0.f);
+	for (int i = 0; i < SH_COEFFICIENTS; i++)
+		result += m_sh[i] * y[i];
+	return glm::max (result, glm::vec3 (0.f));
+}
+
+glm::vec3 Environment::lookup (const glm::vec3 & direction) const {
+	// Face and coordinates in [-1, 1] of the direction, inverting texelDirection
+	const glm::vec3 a = glm::abs (direction);
+	int face;
+	float s, t;
+	if (a.x >= a.y && a.x >= a.z) {
+		face = direction.x > 0.f ? 0 : 1;
+		s = (direction.x > 0.f ? -direction.z : direction.z) / a.x;
+		t = -direction.y / a.x;
+	} else if (a.y >= a.z) {
+		face = direction.y > 0.f ? 2 : 3;
+		s = direction.x / a.y;
+		t = (direction.y > 0.f ? direction.z : -direction.z) / a.y;
+	} else {
+		face = direction.z > 0.f ? 4 : 5;
+		s = (direction.z > 0.f ? direction.x : -direction.x) / a.z;
+		t = -direction.y / a.z;
+	}
+	// Bilinear, clamped to the edges of the face
+	const float u = glm::clamp ((s + 1.f) * 0.5f * m_size - 0.5f, 0.f, m_size - 1.f);
+	const float v = glm::clamp ((t + 1.f) * 0.5f * m_size - 0.5f, 0.f, m_size - 1.f);
+	const int x0 = static_cast<int> (u), y0 = static_cast<int> (v);
+	const int x1 = std::min (x0 + 1, m_size - 1), y1 = std::min (y0 + 1, m_size - 1);
+	auto texel = [&] (int x, int y) {
+		const float * rgb = &m_levels[0][((size_t (face) * m_size + y) * m_size + x) * 3];
+		return glm::vec3 (rgb[0], rgb[1], rgb[2]);
+	};
+	return glm::mix (glm::mix (texel (x0, y0), texel (x1, y0), u - x0), glm::mix (texel (x0, y1), texel (x1, y1), u - x0), v - y0);
+}
+
+void Environment::compute (ThreadPool & pool, const std::vector<std::string> & faces) {
+	// Each task decodes a face, averages it down to the finest prefiltered level, and projects that level.
+	// The area average loses nothing the L2 projection could capture.
+	struct Face {
+		int width = 0, height = 0, size = 0;
+		std::vector<float> texels;
+		glm::vec3 sh[SH_COEFFICIENTS];
+		float weight = 0.f;
+		std::string error;
+	};
+	std::vector<Face> results (6);
+	std::vector<std::future<void>> tasks;
+	for (int f = 0; f < 6; f++)
+		tasks.push_back (pool.submit ([&faces, &results, f] {
+			Trace::Scope scope ("environment face");
+			Face & result = results[f];
+			int channels;
+			unsigned char * data = stbi_load (faces[f].c_str (), &result.width, &result.height, &channels, 3);
+			if (!data) {
+				result.error = "Cannot load " + faces[f];
+				return;
+			}
+			const int w = result.width, h = result.height;
+			const int size = result.size = std::min (w, PREFILTERED_SIZE);
+			result.texels.assign (size * size * 3, 0.f);
+			for (int y = 0; y < size; y++)
+				for (int x = 0; x < size; x++) {
+					int x0 = x * w / size, x1 = (x + 1) * w / size, y0 = y * h / size, y1 = (y + 1) * h / size;
+					float sum[3] = { 0.f, 0.f, 0.f };
+					for (int sy = y0; sy < y1; sy++)
+						for (int sx = x0; sx < x1; sx++)
+							for (int c = 0; c < 3; c++)
+								sum[c] += data[(sy * w + sx) * 3 + c];
+					for (int c = 0; c < 3; c++)
+						result.texels[(y * size + x) * 3 + c] = sum[c] / (255.f * (x1 - x0) * (y1 - y0));
+				}
+			stbi_image_free (data);
+
+			for (auto & c : result.sh)
+				c = glm::vec3 (0.f);
+			for (int y = 0; y < size; y++)
+				for (int x = 0; x < size; x++) {
+					glm::vec3 d = texelDirection (f, x, y, size);
+					// Solid angle of the texel: its area on the unit cube, foreshortened and divided by the squared distance
+					float length2 = glm::dot (d, d);
+					float weight = 4.f / (size * size * length2 * std::sqrt (length2));
+					float basis[SH_COEFFICIENTS];
+					shBasis (d / std::sqrt (length2), basis);
+					const float * texel = &result.texels[(y * size + x) * 3];
+					for (int i = 0; i < SH_COEFFICIENTS; i++)
+						result.sh[i] += glm::vec3 (texel[0], texel[1], texel[2]) * (basis[i] * weight);
+					result.weight += weight;
+				}
+		}));
+	for (auto & task : tasks) // all of them before any get (), which may throw, as they write into results
+		pool.wait (task);
+	for (auto & task : tasks)
+		task.get ();
+
+	for (int f = 0; f < 6; f++) {
+		if (!results[f].error.empty ())
+			throw std::runtime_error ("[Environment][compute] " + results[f].error);
+		if (results[f].width != results[f].height || results[f].width != results[0].width)
+			throw std::runtime_error ("[Environment][compute] The faces are not squares of the same size");
+	}
+
+	// The solid angles are normalized to cover exactly the sphere
+	float weight = 0.f;
+	for (const auto & face : results)
+		weight += face.weight;
+	m_sh.assign (SH_COEFFICIENTS, glm::vec3 (0.f));
+	for (const auto & face : results)
+		for (int i = 0; i < SH_COEFFICIENTS; i++)
+			m_sh[i] += face.sh[i] * (4.f * glm::pi<float> () / weight);
+
+	// Coarser levels average 2x2 texels of the previous one, down to 1x1
+	m_size = results[0].size;
+	m_levels.assign (1, std::vector<float> ());
+	for (const auto & face : results)
+		m_levels[0].insert (m_levels[0].end (), face.texels.begin (), face.texels.end ());
+	for (int parent = m_size, size = m_size / 2; size >= 1; parent = size, size /= 2) {
+		const std::vector<float> & src = m_levels.back ();
+		std::vector<float> level (6 * size * size * 3);
+		for (int f = 0; f < 6; f++)
+			for (int y = 0; y < size; y++)
+				for (int x = 0; x < size; x++)
+					for (int c = 0; c < 3; c++) {
+						float sum = 0.f;
+						for (int k = 0; k < 4; k++) {
+							int sx = std::min (2 * x + (k & 1), parent - 1), sy = std::min (2 * y + (k >> 1), parent - 1);
+							sum += src[((f * parent + sy) * parent + sx) * 3 + c];
+						}
+						level[((f * size + y) * size + x) * 3 + c] = sum / 4.f;
+					}
+		m_levels.push_back (level);
+	}
+}
+
+std::vector<int64_t> Environment::sourceStamps (const std::vector<std::string> & files) {
+	std::vector<int64_t> result;
+	for (const auto & file : files) {
+		struct stat info;
+		if (stat (file.c_str (), &info) != 0)
+			throw std::runtime_error ("[Environment][sourceStamps] Cannot open " + file);
+		result.push_back (static_cast<int64_t> (info.st_size));
+		result.push_back (static_cast<int64_t> (info.st_mtime));
+	}
+	return result;
+}
+
+bool Environment::loadCache (const std::string & filename, const std::vector<std::string> & faces) {
+	ifstream in (filename.c_str (), std::ios::binary);
+	if (!in)
+		return false;
+	char magic[4];
+	std::vector<int64_t> expected = sourceStamps (faces), found (expected.size ());
+	int32_t size = 0, levels = 0;
+	in.read (magic, 4);
+	in.read (reinterpret_cast<char *> (found.data ()), found.size () * sizeof (int64_t));
+	in.read (reinterpret_cast<char *> (&size), sizeof (size));
+	in.read (reinterpret_cast<char *> (&levels), sizeof (levels));
+	if (!in || !std::equal (magic, magic + 4, CACHE_MAGIC) || found != expected || size <= 0 || levels <= 0)
+		return false;
+	m_sh.resize (SH_COEFFICIENTS);
+	in.read (reinterpret_cast<char *> (m_sh.data ()), SH_COEFFICIENTS * sizeof (glm::vec3));
+	m_levels.resize (levels);
+	for (int level = 0; level < levels; level++) {
+		int s = std::max (1, size >> level);
+		m_levels[level].resize (6 * s * s * 3);
+		in.read (reinterpret_cast<char *> (m_levels[level].data ()), m_levels[level].size () * sizeof (float));
+	}
+	m_size = size;
+	return static_cast<bool> (in);
+}
+
+void Environment::saveCache (const std::string & filename, const std::vector<std::string> & faces) const {
+	ofstream out (filename.c_str (), std::ios::binary);
+	if (!out) {
+		std::cout << " > Cannot write the environment cache " << filename << std::endl;
+		return;
+	}
+	std::vector<int64_t> faceStamps = sourceStamps (faces);
+	int32_t size = m_size, levels = static_cast<int32_t> (m_levels.size ());
+	out.write (CACHE_MAGIC, 4);
+	out.write (reinterpret_cast<const char *> (faceStamps.data ()), faceStamps.size () * sizeof (int64_t));
+	out.write (reinterpret_cast<const char *> (&size), sizeof (size));
+	out.write (reinterpret_cast<const char *> (&levels), sizeof (levels));
+	out.write (reinterpret_cast<const char *> (m_sh.data ()), SH_COEFFICIENTS * sizeof (glm::vec3));
+	for (const auto & level : m_levels)
+		out.write (reinterpret_cast<const char *> (level.data ()), level.size () * sizeof (float));
+}
+
+void Environment::upload () {
+	if (m_id)
+		return;
+	Trace::Scope scope ("upload environment");
+	glCreateTextures (GL_TEXTURE_CUBE_MAP, 1, &m_id);
+	glTextureStorage2D (m_id, levels (), GL_RGB16F, m_size, m_size);
+	for (GLsizei level = 0; level < levels (); level++) {
+		GLsizei size = std::max (1, m_size >> level);
+		// The six faces are the layers of a cube map
+		glTextureSubImage3D (m_id, level, 0, 0, 0, size, size, 6, GL_RGB, GL_FLOAT, m_levels[level].data ());
+	}
+	glTextureParameteri (m_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri (m_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri (m_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri (m_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri (m_id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
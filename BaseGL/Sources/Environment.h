@@ -0,0 +1,65 @@
+#ifndef ENVIRONMENT_H
+#define ENVIRONMENT_H
+
+#include <glad/glad.h>
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ThreadPool.h"
+
+/// Sky lighting precomputed from the six faces of a cube map: the L2 spherical harmonics projection of its radiance,
+/// and a small prefiltered mip chain for cone lookups. Both are computed on the thread pool, one task per face,
+/// and cached in a file next to the first face, which is reused as long as the faces do not change.
+/// The construction makes no OpenGL call, so that it can run on a worker thread; upload () then creates the cube map.
+class Environment {
+public:
+	/// Number of L2 spherical harmonics coefficients, per color channel
+	static const int SH_COEFFICIENTS = 9;
+
+	/// Size of the finest level of the prefiltered chain, for faces at least that large
+	static const int PREFILTERED_SIZE = 128;
+
+	/// Faces in the +X, -X, +Y, -Y, +Z, -Z order of loadCubemap. May run on a task of the pool.
+	Environment (ThreadPool & pool, const std::vector<std::string> & faces);
+	virtual ~Environment ();
+
+	Environment (const Environment &) = delete;
+	Environment & operator= (const Environment &) = delete;
+
+	/// Creates the prefiltered cube map, once. A valid OpenGL context must be active.
+	void upload ();
+
+	/// Prefiltered cube map: each level averages the radiance of the source texels it covers. 0 until uploaded.
+	inline GLuint prefiltered () const { return m_id; }
+	inline GLsizei size () const { return m_size; }
+	inline GLsizei levels () const { return static_cast<GLsizei> (m_levels.size ()); }
+
+	/// GPU memory of the prefiltered cube map
+	size_t gpuBytes () const;
+
+	/// Spherical harmonics coefficients of the radiance, in the order of radiance ()
+	inline const std::vector<glm::vec3> & sh () const { return m_sh; }
+
+	/// Radiance reconstructed from the spherical harmonics in the given (unit) direction
+	glm::vec3 radiance (const glm::vec3 & direction) const;
+
+	/// Radiance of the finest prefiltered level in the given direction, filtered within its face, without any OpenGL call
+	glm::vec3 lookup (const glm::vec3 & direction) const;
+
+	/// Size and modification time of each file, so that the caches derived from them are dropped when one changes
+	static std::vector<int64_t> sourceStamps (const std::vector<std::string> & files);
+
+private:
+	void compute (ThreadPool & pool, const std::vector<std::string> & faces);
+	bool loadCache (const std::string & filename, const std::vector<std::string> & faces);
+	void saveCache (const std::string & filename, const std::vector<std::string> & faces) const;
+
+	GLuint m_id = 0;
+	GLsizei m_size = 0;
+	std::vector<glm::vec3> m_sh;
+	std::vector<std::vector<float>> m_levels; // RGB texels of the six faces of each level, face after face
+};
+
+#endif // ENVIRONMENT_H
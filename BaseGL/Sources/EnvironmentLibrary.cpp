@@ -0,0 +1,203 @@
+#include "EnvironmentLibrary.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+EnvironmentLibrary::EnvironmentLibrary (ThreadPool & pool, const std::vector<std::vector<std::string>> & skies, size_t budget)
+	: m_pool (pool), m_entries (skies.size ()), m_budget (budget) {
+	if (skies.empty ())
+		throw std::runtime_error ("[EnvironmentLibrary][EnvironmentLibrary] No sky");
+	for (size_t i = 0; i < skies.size (); i++) {
+		m_entries[i].faces = skies[i];
+		const std::string & face = skies[i].at (0);
+		size_t separator = face.find_last_of ("/\\");
+		m_entries[i].name = separator == std::string::npos ? "." : face.substr (0, separator);
+	}
+}
+
+EnvironmentLibrary::~EnvironmentLibrary () {
+	for (auto & entry : m_entries) {
+		if (entry.state == Entry::LOADING) { // the workers write into the mapped buffer until they are done
+			cancelCubemap (entry.pendingCubemap);
+			entry.pendingEnvironment.wait ();
+		} else if (entry.state == Entry::RESIDENT)
+			glDeleteTextures (1, &entry.cubemap);
+	}
+}
+
+void EnvironmentLibrary::request (int index) {
+	m_requested = index;
+	if (m_entries[index].state == Entry::UNLOADED || m_entries[index].state == Entry::FAILED)
+		load (index);
+}
+
+bool EnvironmentLibrary::update () {
+	// One upload per call at most, the requested sky first, so that a frame never pays for several
+	int next = -1;
+	if (m_requested >= 0 && m_entries[m_requested].state == Entry::LOADING && ready (m_entries[m_requested]))
+		next = m_requested;
+	for (int i = 0; i < size () && next < 0; i++)
+		if (m_entries[i].state == Entry::LOADING && ready (m_entries[i]))
+			next = i;
+	if (next >= 0) {
+		try {
+			finish (next);
+		} catch (const std::exception & e) {
+			std::cout << " > Cannot load the sky " << m_entries[next].name << ": " << e.what () << std::endl;
+			if (next == m_requested)
+				m_requested = m_current;
+		}
+	}
+	bool changed = false;
+	if (m_requested >= 0 && m_requested != m_current && m_entries[m_requested].state == Entry::RESIDENT) {
+		makeCurrent (m_requested);
+		changed = true;
+	}
+	evictOverBudget ();
+	prefetch ();
+	return changed;
+}
+
+void EnvironmentLibrary::wait () {
+	if (m_entries[m_requested].state == Entry::LOADING)
+		finish (m_requested);
+	if (m_entries[m_requested].state != Entry::RESIDENT)
+		throw std::runtime_error ("[EnvironmentLibrary][wait] Cannot load " + m_entries[m_requested].name);
+	makeCurrent (m_requested);
+	prefetch ();
+}
+
+bool EnvironmentLibrary::loading () const {
+	for (const auto & entry : m_entries)
+		if (entry.state == Entry::LOADING)
+			return true;
+	return false;
+}
+
+size_t EnvironmentLibrary::residentBytes () const {
+	size_t bytes = 0;
+	for (const auto & entry : m_entries)
+		bytes += entry.bytes;
+	return bytes;
+}
+
+void EnvironmentLibrary::load (int index) {
+	Entry & entry = m_entries[index];
+	try {
+		entry.pendingCubemap = startCubemap (m_pool, entry.faces);
+	} catch (...) {
+		entry.state = Entry::FAILED;
+		throw;
+	}
+	const std::vector<std::string> faces = entry.faces;
+	ThreadPool & pool = m_pool;
+	entry.pendingEnvironment = m_pool.submit ([&pool, faces] { return std::make_shared<Environment> (pool, faces); });
+	entry.state = Entry::LOADING;
+}
+
+bool EnvironmentLibrary::ready (const Entry & entry) const {
+	return cubemapReady (entry.pendingCubemap)
+		&& entry.pendingEnvironment.wait_for (std::chrono::seconds (0)) == std::future_status::ready;
+}
+
+void EnvironmentLibrary::finish (int index) {
+	Entry & entry = m_entries[index];
+	entry.state = Entry::FAILED; // unless both parts load
+	std::shared_ptr<Environment> environment;
+	try {
+		environment = entry.pendingEnvironment.get ();
+	} catch (...) {
+		cancelCubemap (entry.pendingCubemap);
+		throw;
+	}
+	size_t bytes = cubemapBytes (entry.pendingCubemap);
+	entry.cubemap = finishCubemap (entry.pendingCubemap);
+	environment->upload ();
+	entry.environment = environment;
+	entry.bytes = bytes + environment->gpuBytes ();
+	entry.loadedBytes = entry.bytes;
+	entry.state = Entry::RESIDENT;
+}
+
+void EnvironmentLibrary::evict (int index) {
+	Entry & entry = m_entries[index];
+	glDeleteTextures (1, &entry.cubemap);
+	entry.cubemap = 0;
+	entry.environment.reset ();
+	entry.bytes = 0;
+	entry.state = Entry::UNLOADED;
+	std::cout << " > Sky " << entry.name << " evicted" << std::endl;
+}
+
+void EnvironmentLibrary::makeCurrent (int index) {
+	m_current = index;
+	m_entries[index].lastUse = ++m_clock;
+	evictOverBudget ();
+	int resident = 0;
+	for (const auto & entry : m_entries)
+		resident += entry.state == Entry::RESIDENT;
+	std::cout << " > Sky " << m_entries[index].name << " (" << index + 1 << "/" << size () << "), "
+			  << resident << " resident in " << (residentBytes () >> 20) << " MB of " << (m_budget >> 20) << " MB" << std::endl;
+}
+
+int EnvironmentLibrary::leastRecentlyUsed (const std::vector<int> & kept) const {
+	int victim = -1;
+	for (int i = 0; i < size (); i++)
+		if (m_entries[i].state == Entry::RESIDENT && std::find (kept.begin (), kept.end (), i) == kept.end ()
+			&& (victim < 0 || m_entries[i].lastUse < m_entries[victim].lastUse))
+			victim = i;
+	return victim;
+}
+
+std::vector<int> EnvironmentLibrary::neighbours () const {
+	if (m_current < 0 || size () < 2)
+		return {};
+	return { (m_current + 1) % size (), (m_current + size () - 1) % size () };
+}
+
+void EnvironmentLibrary::evictOverBudget () {
+	// The neighbours of the current sky go last: they were prefetched to fit, and evicting them would load them again
+	std::vector<int> kept = neighbours ();
+	kept.push_back (m_current);
+	while (residentBytes () > m_budget) {
+		int victim = leastRecentlyUsed (kept);
+		if (victim < 0)
+			victim = leastRecentlyUsed ({ m_current });
+		if (victim < 0)
+			return; // the current sky alone
+		evict (victim);
+	}
+}
+
+void EnvironmentLibrary::prefetch () {
+	// One sky at a time, the next one in the list first, then the previous one. To make room, the skies other than
+	// the current one and its neighbours are evicted, least recently used first. The size of a sky never loaded is
+	// estimated by the current one, and a sky known not to fit beside the current one is not prefetched.
+	if (m_current < 0 || size () < 2 || loading ())
+		return;
+	const std::vector<int> candidates = neighbours ();
+	for (int candidate : candidates) {
+		if (m_entries[candidate].state != Entry::UNLOADED)
+			continue;
+		const size_t estimate = m_entries[candidate].loadedBytes > 0 ? m_entries[candidate].loadedBytes : m_entries[m_current].bytes;
+		if (m_entries[m_current].bytes + estimate > m_budget)
+			continue;
+		while (residentBytes () + estimate > m_budget) {
+			int victim = leastRecentlyUsed ({ m_current, candidates[0], candidates[1] });
+			if (victim < 0)
+				return; // no room
+			evict (victim);
+		}
+		try {
+			load (candidate);
+		} catch (const std::exception & e) {
+			std::cout << " > Cannot prefetch the sky " << m_entries[candidate].name << ": " << e.what () << std::endl;
+			continue;
+		}
+		return;
+	}
+}
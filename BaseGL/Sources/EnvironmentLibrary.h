@@ -0,0 +1,93 @@
+#ifndef ENVIRONMENT_LIBRARY_H
+#define ENVIRONMENT_LIBRARY_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+
+#include "ThreadPool.h"
+#include "Texture.h"
+#include "Environment.h"
+
+/// Set of skies to switch between at runtime: the cube map of each, and its Environment (sky lighting).
+/// The most recently used ones stay resident on the GPU as long as they fit in a memory budget. The others are loaded
+/// on the thread pool, the requested one first, then its neighbours in the list, so that switching to the next
+/// or the previous sky does not wait for its decoding. Every method requires a valid OpenGL context.
+class EnvironmentLibrary {
+public:
+	/// Faces of each sky in the order of startCubemap, and budget in bytes of GPU memory.
+	/// The current sky stays resident even if it does not fit.
+	EnvironmentLibrary (ThreadPool & pool, const std::vector<std::vector<std::string>> & skies, size_t budget);
+	virtual ~EnvironmentLibrary ();
+
+	EnvironmentLibrary (const EnvironmentLibrary &) = delete;
+	EnvironmentLibrary & operator= (const EnvironmentLibrary &) = delete;
+
+	inline int size () const { return static_cast<int> (m_entries.size ()); }
+
+	/// Directory of the faces of a sky
+	inline const std::string & name (int index) const { return m_entries[index].name; }
+
+	/// Sky displayed, -1 until the first one is resident
+	inline int current () const { return m_current; }
+
+	/// Sky to display once resident
+	inline int requested () const { return m_requested; }
+
+	/// Cube map and sky lighting of the current sky
+	inline GLuint cubemap () const { return m_entries[m_current].cubemap; }
+	inline std::shared_ptr<Environment> environment () const { return m_entries[m_current].environment; }
+
+	/// Starts loading the given sky, unless it is resident. It becomes current in update () or wait ().
+	/// Throws if its faces cannot be read.
+	void request (int index);
+
+	/// Uploads the skies whose loading is over, makes the requested one current once resident, evicts the least
+	/// recently used ones over the budget, and prefetches the neighbours of the current one.
+	/// Returns whether the current sky changed.
+	bool update ();
+
+	/// Waits for the requested sky and makes it current. Throws if it cannot be loaded.
+	void wait ();
+
+	/// Whether skies are being loaded in the background, i.e., update () has more to do
+	bool loading () const;
+
+	/// GPU memory of the resident skies
+	size_t residentBytes () const;
+
+private:
+	struct Entry {
+		std::vector<std::string> faces;
+		std::string name;
+		enum State { UNLOADED, LOADING, RESIDENT, FAILED } state = UNLOADED;
+		PendingCubemap pendingCubemap;
+		std::future<std::shared_ptr<Environment>> pendingEnvironment;
+		GLuint cubemap = 0;
+		std::shared_ptr<Environment> environment;
+		size_t bytes = 0;
+		size_t loadedBytes = 0; // GPU memory of the last load, kept once evicted to budget the prefetches
+		unsigned long lastUse = 0; // clock of the last time the sky was current
+	};
+
+	void load (int index);
+	bool ready (const Entry & entry) const;
+	void finish (int index);
+	void evict (int index);
+	void makeCurrent (int index);
+	int leastRecentlyUsed (const std::vector<int> & kept) const; // resident sky, -1 if none
+	std::vector<int> neighbours () const; // of the current sky, next one first
+	void evictOverBudget ();
+	void prefetch ();
+
+	ThreadPool & m_pool;
+	std::vector<Entry> m_entries;
+	size_t m_budget;
+	int m_current = -1;
+	int m_requested = -1;
+	unsigned long m_clock = 0;
+};
+
+#endif // ENVIRONMENT_LIBRARY_H
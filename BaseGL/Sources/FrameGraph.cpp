@@ -0,0 +1,171 @@
+#include "FrameGraph.h"
+
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+#include "Trace.h"
+
+using namespace std;
+
+const std::string FrameGraph::BACKBUFFER ("backbuffer");
+
+void FrameGraph::addPass (const Pass & pass) {
+	m_dirty = true;
+	for (auto & p : m_passes)
+		if (p.name == pass.name) {
+			p = pass;
+			return;
+		}
+	m_passes.push_back (pass);
+}
+
+void FrameGraph::removePass (const std::string & name) {
+	m_dirty = true;
+	m_passes.erase (std::remove_if (m_passes.begin (), m_passes.end (),
+									[&] (const Pass & p) { return p.name == name; }),
+					m_passes.end ());
+}
+
+void FrameGraph::compile () {
+	Trace::Scope scope ("compile frame graph");
+	// Which pass produces each target. Targets produced by no pass are external (e.g., last frame's history).
+	std::map<std::string, size_t> producer;
+	for (size_t i = 0; i < m_passes.size (); i++) {
+		std::vector<std::string> written = m_passes[i].outputs;
+		if (!m_passes[i].depth.empty ())
+			written.push_back (m_passes[i].depth);
+		for (const auto & target : written) {
+			if (producer.count (target))
+				throw std::runtime_error ("[Frame Graph][compile] " + target + " is written by both "
+										  + m_passes[producer[target]].name + " and " + m_passes[i].name);
+			producer[target] = i;
+		}
+	}
+
+	// Depth-first walk from the backbuffer: a pass is scheduled after the producers of all its inputs
+	enum State { UNVISITED, VISITING, DONE };
+	std::vector<State> state (m_passes.size (), UNVISITED);
+	m_schedule.clear ();
+	std::function<void (size_t)> visit = [&] (size_t i) {
+		if (state[i] == DONE)
+			return;
+		if (state[i] == VISITING)
+			throw std::runtime_error ("[Frame Graph][compile] Cycle through pass " + m_passes[i].name);
+		state[i] = VISITING;
+		for (const auto & input : m_passes[i].inputs) {
+			auto it = producer.find (input.target);
+			if (it != producer.end () && it->second != i)
+				visit (it->second);
+		}
+		state[i] = DONE;
+		m_schedule.push_back (i);
+	};
+	for (size_t i = 0; i < m_passes.size (); i++) {
+		const auto & outputs = m_passes[i].outputs;
+		if (std::find (outputs.begin (), outputs.end (), BACKBUFFER) != outputs.end ())
+			visit (i);
+	}
+	m_dirty = false;
+
+	// Lifetime of each target over the schedule, so that transient targets which are never alive
+	// at the same time share their storage (e.g., the raw SSDO is dead once blurred, unless displayed)
+	std::map<std::string, RenderTargetManager::Lifetime> lifetimes;
+	for (int step = 0; step < static_cast<int> (m_schedule.size ()); step++) {
+		const Pass & pass = m_passes[m_schedule[step]];
+		std::vector<std::string> used = pass.outputs;
+		if (!pass.depth.empty ())
+			used.push_back (pass.depth);
+		for (const auto & input : pass.inputs)
+			used.push_back (input.target);
+		for (const auto & target : used) {
+			if (target == BACKBUFFER)
+				continue;
+			auto it = lifetimes.find (target);
+			if (it == lifetimes.end ())
+				lifetimes[target] = { step, step };
+			else
+				it->second.last = step;
+		}
+	}
+
+	std::cout << " > Frame graph:";
+	for (const auto & name : schedule ())
+		std::cout << " " << name;
+	std::cout << " (" << m_passes.size () - m_schedule.size () << " culled)" << std::endl;
+	m_targetsPtr->setLifetimes (lifetimes);
+}
+
+void FrameGraph::bindOutputs (const Pass & pass, GLsizei width, GLsizei height) {
+	if (pass.compute) {
+		for (size_t i = 0; i < pass.outputs.size (); i++) {
+			const RenderTarget & target = m_targetsPtr->target (pass.outputs[i]);
+			GLboolean layered = target.desc ().layers > 1 ? GL_TRUE : GL_FALSE;
+			glBindImageTexture (static_cast<GLuint> (i), target.id (), 0, layered, 0, GL_WRITE_ONLY, target.desc ().format);
+		}
+	} else if (std::find (pass.outputs.begin (), pass.outputs.end (), BACKBUFFER) != pass.outputs.end ()) {
+		glBindFramebuffer (GL_FRAMEBUFFER, 0);
+		glViewport (0, 0, width, height);
+	} else
+		m_targetsPtr->bind (pass.outputs, pass.depth);
+}
+
+void FrameGraph::beginMask (const Pass & pass) {
+	if (pass.masked && !pass.compute) {
+		const RenderTargetDesc & desc = m_targetsPtr->target (pass.outputs[0]).desc ();
+		Rect rect = coverage (desc.width, desc.height);
+		glEnable (GL_SCISSOR_TEST);
+		glScissor (rect.x, rect.y, rect.width, rect.height);
+	}
+}
+
+void FrameGraph::endMask (const Pass & pass) {
+	if (pass.masked && !pass.compute)
+		glDisable (GL_SCISSOR_TEST);
+}
+
+void FrameGraph::execute (GLsizei width, GLsizei height) {
+	if (m_dirty)
+		compile ();
+	for (size_t i : m_schedule) {
+		const Pass & pass = m_passes[i];
+		Trace::Scope scope (pass.name);
+		Trace::beginGpu (pass.name);
+		bindOutputs (pass, width, height);
+		for (const auto & input : pass.inputs)
+			glBindTextureUnit (input.unit, m_targetsPtr->texture (input.target));
+		beginMask (pass);
+		pass.execute ();
+		endMask (pass);
+		if (pass.compute) // Image stores are not synchronized with the passes sampling or blitting the outputs
+			glMemoryBarrier (GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+		Trace::endGpu ();
+		if (m_profilerPtr)
+			m_profilerPtr->endPass (pass.name);
+	}
+	glBindFramebuffer (GL_FRAMEBUFFER, 0);
+}
+
+std::vector<std::string> FrameGraph::schedule () const {
+	std::vector<std::string> names;
+	for (size_t i : m_schedule)
+		names.push_back (m_passes[i].name);
+	return names;
+}
+
+void FrameGraph::setCoverage (float x0, float y0, float x1, float y1) {
+	m_coverage[0] = x0;
+	m_coverage[1] = y0;
+	m_coverage[2] = x1;
+	m_coverage[3] = y1;
+}
+
+FrameGraph::Rect FrameGraph::coverage (GLsizei width, GLsizei height) const {
+	GLint x0 = std::max (0, static_cast<GLint> (std::floor (m_coverage[0] * width)));
+	GLint y0 = std::max (0, static_cast<GLint> (std::floor (m_coverage[1] * height)));
+	GLint x1 = std::min (width, static_cast<GLint> (std::ceil (m_coverage[2] * width)));
+	GLint y1 = std::min (height, static_cast<GLint> (std::ceil (m_coverage[3] * height)));
+	return { x0, y0, std::max (0, x1 - x0), std::max (0, y1 - y0) };
+}
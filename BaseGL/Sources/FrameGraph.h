@@ -0,0 +1,79 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "RenderTarget.h"
+#include "Profiler.h"
+
+/// Declarative description of the passes of a frame. Each pass lists the render targets it reads and writes;
+/// the graph culls the passes that do not contribute to the window, orders the others and binds their targets.
+class FrameGraph {
+public:
+	/// Pass output standing for the window framebuffer
+	static const std::string BACKBUFFER;
+
+	/// Render target read by a pass, and the texture unit it is bound to
+	struct Input {
+		std::string target;
+		GLuint unit;
+	};
+
+	struct Pass {
+		std::string name;
+		std::vector<Input> inputs;
+		std::vector<std::string> outputs; // Color targets, or BACKBUFFER
+		std::string depth; // Optional depth target
+		std::function<void ()> execute; // Issues the draw calls, with outputs and inputs already bound
+		bool compute = false; // Outputs are bound as images, to units 0, 1, ..., instead of a framebuffer
+		bool masked = false; // Only needed where geometry was drawn: scissored to the coverage rectangle
+	};
+
+	/// Rectangle of pixels
+	struct Rect {
+		GLint x, y;
+		GLsizei width, height;
+	};
+
+	explicit FrameGraph (std::shared_ptr<RenderTargetManager> targetsPtr) : m_targetsPtr (targetsPtr) {}
+
+	/// Adds a pass, or replaces the pass of the same name
+	void addPass (const Pass & pass);
+	void removePass (const std::string & name);
+
+	/// Keeps the passes the backbuffer depends on, producers first. Called by execute when the graph changed.
+	void compile ();
+
+	/// Runs the scheduled passes, the backbuffer having the given size
+	void execute (GLsizei width, GLsizei height);
+
+	/// Times the passes on the GPU from now on, within the frames of the profiler (none to stop)
+	inline void setProfiler (std::shared_ptr<Profiler> profilerPtr) { m_profilerPtr = profilerPtr; }
+
+	/// Names of the scheduled passes, in execution order
+	std::vector<std::string> schedule () const;
+
+	/// Screen area covered by the geometry, in normalized [0,1] coordinates. Masked passes are scissored to it.
+	void setCoverage (float x0, float y0, float x1, float y1);
+
+	/// Coverage rectangle in a target of the given size, rounded outwards. Compute passes dispatch over it themselves.
+	Rect coverage (GLsizei width, GLsizei height) const;
+
+private:
+	void bindOutputs (const Pass & pass, GLsizei width, GLsizei height);
+	void beginMask (const Pass & pass);
+	void endMask (const Pass & pass);
+
+	std::shared_ptr<RenderTargetManager> m_targetsPtr;
+	std::shared_ptr<Profiler> m_profilerPtr;
+	std::vector<Pass> m_passes;
+	std::vector<size_t> m_schedule;
+	bool m_dirty = true;
+	float m_coverage[4] = { 0.f, 0.f, 1.f, 1.f };
+};
+
+#endif // FRAME_GRAPH_H
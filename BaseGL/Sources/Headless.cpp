@@ -0,0 +1,130 @@
+#include "Headless.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef BASEGL_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+using namespace std;
+
+namespace Headless {
+
+#ifdef BASEGL_EGL
+
+// Surfaceless display of Mesa if available, which needs neither a window system nor a device file, the default one otherwise
+static EGLDisplay openDisplay () {
+	const char * extensions = eglQueryString (EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC> (eglGetProcAddress ("eglGetPlatformDisplayEXT"));
+	if (extensions && std::string (extensions).find ("EGL_MESA_platform_surfaceless") != std::string::npos && getPlatformDisplay) {
+		EGLDisplay display = getPlatformDisplay (EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display != EGL_NO_DISPLAY)
+			return display;
+	}
+	return eglGetDisplay (EGL_DEFAULT_DISPLAY);
+}
+
+Context::Context () {
+	EGLDisplay display = openDisplay ();
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize (display, &major, &minor))
+		throw std::runtime_error ("[Headless][Context] Cannot initialize an EGL display");
+	m_display = display;
+	const char * extensions = eglQueryString (display, EGL_EXTENSIONS);
+	if (!extensions || std::string (extensions).find ("EGL_KHR_surfaceless_context") == std::string::npos) {
+		eglTerminate (display);
+		throw std::runtime_error ("[Headless][Context] The EGL display does not support surfaceless contexts");
+	}
+	// No surface is created, the frames are only rendered into the render targets: any configuration does, but the
+	// surfaceless displays only have pbuffer ones, and eglChooseConfig looks for window ones by default
+	const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint configs = 0;
+	eglChooseConfig (display, configAttributes, &config, 1, &configs);
+	const EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 5,
+										 EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	EGLContext context = EGL_NO_CONTEXT;
+	if (configs > 0 && eglBindAPI (EGL_OPENGL_API))
+		context = eglCreateContext (display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent (display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		if (context != EGL_NO_CONTEXT)
+			eglDestroyContext (display, context);
+		eglTerminate (display);
+		throw std::runtime_error ("[Headless][Context] Cannot create an OpenGL 4.5 core context");
+	}
+	m_context = context;
+}
+
+Context::~Context () {
+	eglMakeCurrent (m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext (m_display, m_context);
+	eglTerminate (m_display);
+}
+
+void * Context::getProcAddress (const char * name) {
+	return reinterpret_cast<void *> (eglGetProcAddress (name));
+}
+
+#else
+
+Context::Context () {
+	throw std::runtime_error ("[Headless][Context] Built without EGL: no headless rendering");
+}
+
+Context::~Context () {}
+
+void * Context::getProcAddress (const char *) {
+	return nullptr;
+}
+
+#endif
+
+Pose parsePose (const std::string & text) {
+	std::string values = text;
+	std::replace (values.begin (), values.end (), ',', ' ');
+	istringstream in (values);
+	Pose pose;
+	in >> pose.translation.x >> pose.translation.y >> pose.translation.z >> pose.rotation.x >> pose.rotation.y >> pose.rotation.z;
+	std::string rest;
+	if (in.fail () || (in >> rest))
+		throw std::runtime_error ("[Headless][parsePose] Expected \"tx ty tz rx ry rz\", got \"" + text + "\"");
+	return pose;
+}
+
+std::vector<Pose> readPoses (const std::string & filename) {
+	ifstream in (filename.c_str ());
+	if (!in)
+		throw std::runtime_error ("[Headless][readPoses] Cannot open " + filename);
+	std::vector<Pose> poses;
+	std::string line;
+	while (std::getline (in, line)) {
+		if (!line.empty () && line.back () == '\r')
+			line.pop_back ();
+		if (line.find_first_not_of (" \t") == std::string::npos || line[line.find_first_not_of (" \t")] == '#')
+			continue;
+		poses.push_back (parsePose (line));
+	}
+	return poses;
+}
+
+bool writePng (const std::string & filename, int width, int height, const std::vector<unsigned char> & rgba) {
+	// The alpha of the render targets is not an opacity
+	std::vector<unsigned char> rgb (size_t (width) * height * 3);
+	for (int y = 0; y < height; y++) {
+		const unsigned char * source = &rgba[size_t (height - 1 - y) * width * 4];
+		unsigned char * destination = &rgb[size_t (y) * width * 3];
+		for (int x = 0; x < width; x++)
+			for (int c = 0; c < 3; c++)
+				destination[3 * x + c] = source[4 * x + c];
+	}
+	return stbi_write_png (filename.c_str (), width, height, 3, rgb.data (), width * 3) != 0;
+}
+
+}
@@ -0,0 +1,49 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+/// Rendering without a display, e.g., on build servers: an OpenGL context without any window or surface, which renders
+/// into the render targets only, the camera poses to render, and the PNG files the frames are written to.
+namespace Headless {
+
+/// OpenGL 4.5 core context of a surfaceless EGL display (EGL_MESA_platform_surfaceless, which Mesa's llvmpipe supports),
+/// or of the default display otherwise. Current on the calling thread from its construction to its destruction.
+/// Throws if EGL is missing, or if it cannot create such a context.
+class Context {
+public:
+	Context ();
+	virtual ~Context ();
+
+	Context (const Context &) = delete;
+	Context & operator= (const Context &) = delete;
+
+	/// OpenGL entry points, for the loader
+	static void * getProcAddress (const char * name);
+
+private:
+	void * m_display = nullptr;
+	void * m_context = nullptr;
+};
+
+/// Camera pose: translation and rotation in the conventions of Transform, the angles in degrees
+struct Pose {
+	glm::vec3 translation = glm::vec3 (0.0);
+	glm::vec3 rotation = glm::vec3 (0.0);
+};
+
+/// Pose from its six values "tx ty tz rx ry rz", separated by spaces or commas. Throws if malformed.
+Pose parsePose (const std::string & text);
+
+/// Poses of a file, one per line. Empty lines, and lines starting with '#', are skipped.
+std::vector<Pose> readPoses (const std::string & filename);
+
+/// Writes the color channels of an 8-bit RGBA image, its rows from the bottom as read back from OpenGL, as an RGB PNG file.
+/// Returns false on failure.
+bool writePng (const std::string & filename, int width, int height, const std::vector<unsigned char> & rgba);
+
+}
+
+#endif // HEADLESS_H
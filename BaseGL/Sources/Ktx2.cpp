@@ -0,0 +1,178 @@
+#include "Ktx2.h"
+
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace Ktx2 {
+
+static const unsigned char IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+static const size_t HEADER_SIZE = 12 + 9 * 4 + 4 * 4 + 2 * 8; // identifier, header, data format/key value/supercompression index
+static const size_t LEVEL_INDEX_ENTRY_SIZE = 3 * 8;
+
+// Little-endian fields, from and to byte buffers
+static uint32_t get32 (const unsigned char * bytes) {
+	return uint32_t (bytes[0]) | uint32_t (bytes[1]) << 8 | uint32_t (bytes[2]) << 16 | uint32_t (bytes[3]) << 24;
+}
+
+static uint64_t get64 (const unsigned char * bytes) {
+	return uint64_t (get32 (bytes)) | uint64_t (get32 (bytes + 4)) << 32;
+}
+
+static void put32 (std::vector<unsigned char> & bytes, uint32_t value) {
+	for (int b = 0; b < 4; b++)
+		bytes.push_back (static_cast<unsigned char> (value >> (8 * b)));
+}
+
+static void put64 (std::vector<unsigned char> & bytes, uint64_t value) {
+	put32 (bytes, static_cast<uint32_t> (value));
+	put32 (bytes, static_cast<uint32_t> (value >> 32));
+}
+
+static void pad (std::vector<unsigned char> & bytes, size_t alignment) {
+	while (bytes.size () % alignment)
+		bytes.push_back (0);
+}
+
+bool readHeader (const std::string & filename, Header & header) {
+	std::ifstream in (filename, std::ios::binary);
+	unsigned char bytes[HEADER_SIZE];
+	if (!in.read (reinterpret_cast<char *> (bytes), HEADER_SIZE) || !std::equal (IDENTIFIER, IDENTIFIER + 12, bytes))
+		return false;
+	header.vkFormat = get32 (bytes + 12);
+	header.width = get32 (bytes + 20);
+	header.height = get32 (bytes + 24);
+	header.faceCount = get32 (bytes + 36);
+	uint32_t levelCount = std::max (1u, get32 (bytes + 40));
+	if (get32 (bytes + 44) != 0) // supercompression
+		return false;
+	uint32_t kvdOffset = get32 (bytes + 56), kvdLength = get32 (bytes + 60);
+
+	std::vector<unsigned char> index (levelCount * LEVEL_INDEX_ENTRY_SIZE);
+	if (!in.read (reinterpret_cast<char *> (index.data ()), index.size ()))
+		return false;
+	header.levels.resize (levelCount);
+	for (uint32_t l = 0; l < levelCount; l++) {
+		header.levels[l].offset = get64 (&index[l * LEVEL_INDEX_ENTRY_SIZE]);
+		header.levels[l].length = get64 (&index[l * LEVEL_INDEX_ENTRY_SIZE + 8]);
+	}
+	in.seekg (0, std::ios::end);
+	const uint64_t fileSize = static_cast<uint64_t> (in.tellg ());
+	for (const auto & level : header.levels)
+		if (level.offset + level.length > fileSize) // truncated
+			return false;
+
+	std::vector<unsigned char> kvd (kvdLength);
+	if (!in.seekg (kvdOffset) || !in.read (reinterpret_cast<char *> (kvd.data ()), kvd.size ()))
+		return false;
+	header.keyValues.clear ();
+	for (size_t offset = 0; offset + 4 <= kvd.size ();) {
+		uint32_t length = get32 (&kvd[offset]);
+		if (offset + 4 + length > kvd.size ())
+			return false;
+		std::string entry (reinterpret_cast<const char *> (&kvd[offset + 4]), length);
+		size_t separator = entry.find ('\0');
+		if (separator == std::string::npos)
+			return false;
+		std::string value = entry.substr (separator + 1);
+		if (!value.empty () && value.back () == '\0')
+			value.pop_back ();
+		header.keyValues[entry.substr (0, separator)] = value;
+		offset += (4 + length + 3) / 4 * 4;
+	}
+	return true;
+}
+
+void readLevels (const std::string & filename, const Header & header, unsigned char * data) {
+	std::ifstream in (filename, std::ios::binary);
+	for (const auto & level : header.levels) {
+		if (!in.seekg (level.offset) || !in.read (reinterpret_cast<char *> (data), level.length))
+			throw std::runtime_error ("[Ktx2][readLevels] Cannot read the levels of " + filename);
+		data += level.length;
+	}
+}
+
+void writeBC1Cubemap (const std::string & filename, uint32_t size, const std::vector<uint64_t> & levelLengths,
+                      const std::map<std::string, std::string> & keyValues, const unsigned char * data) {
+	const uint32_t levelCount = static_cast<uint32_t> (levelLengths.size ());
+	const size_t dfdOffset = HEADER_SIZE + levelCount * LEVEL_INDEX_ENTRY_SIZE;
+
+	// Basic data format descriptor of BC1 blocks: one 64 bits sample of 4x4 texels, linear
+	std::vector<unsigned char> dfd;
+	put32 (dfd, 44);            // total size
+	put32 (dfd, 0);             // Khronos vendor, basic descriptor type
+	put32 (dfd, 2 | 40 << 16);  // version, block size
+	put32 (dfd, 128 | 1 << 8 | 1 << 16); // BC1A color model, BT.709 primaries, linear transfer
+	put32 (dfd, 3 | 3 << 8);    // 4x4 texel blocks
+	put32 (dfd, 8);             // bytes per block
+	put32 (dfd, 0);
+	put32 (dfd, 63 << 16);      // bits 0-63, color channel
+	put32 (dfd, 0);             // sample position
+	put32 (dfd, 0);             // lower
+	put32 (dfd, 0xFFFFFFFF);    // upper
+
+	std::vector<unsigned char> kvd;
+	for (const auto & keyValue : keyValues) { // sorted by key, as required
+		put32 (kvd, static_cast<uint32_t> (keyValue.first.size () + keyValue.second.size () + 2));
+		kvd.insert (kvd.end (), keyValue.first.begin (), keyValue.first.end ());
+		kvd.push_back (0);
+		kvd.insert (kvd.end (), keyValue.second.begin (), keyValue.second.end ());
+		kvd.push_back (0);
+		pad (kvd, 4);
+	}
+	const size_t kvdOffset = dfdOffset + dfd.size ();
+
+	// Level data from the smallest level to the largest, each aligned on the 8 bytes of a block
+	std::vector<uint64_t> levelOffsets (levelCount), dataOffsets (levelCount);
+	uint64_t offset = kvdOffset + kvd.size (), dataOffset = 0;
+	for (uint32_t l = 0; l < levelCount; l++) {
+		dataOffsets[l] = dataOffset;
+		dataOffset += levelLengths[l];
+	}
+	for (uint32_t l = levelCount; l-- > 0;) {
+		offset = (offset + 7) / 8 * 8;
+		levelOffsets[l] = offset;
+		offset += levelLengths[l];
+	}
+
+	std::vector<unsigned char> header (IDENTIFIER, IDENTIFIER + 12);
+	put32 (header, VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+	put32 (header, 1);          // type size
+	put32 (header, size);
+	put32 (header, size);
+	put32 (header, 0);          // depth
+	put32 (header, 0);          // not an array
+	put32 (header, 6);          // faces
+	put32 (header, levelCount);
+	put32 (header, 0);          // no supercompression
+	put32 (header, static_cast<uint32_t> (dfdOffset));
+	put32 (header, static_cast<uint32_t> (dfd.size ()));
+	put32 (header, kvd.empty () ? 0 : static_cast<uint32_t> (kvdOffset));
+	put32 (header, static_cast<uint32_t> (kvd.size ()));
+	put64 (header, 0);
+	put64 (header, 0);
+	for (uint32_t l = 0; l < levelCount; l++) {
+		put64 (header, levelOffsets[l]);
+		put64 (header, levelLengths[l]);
+		put64 (header, levelLengths[l]); // uncompressed length
+	}
+	header.insert (header.end (), dfd.begin (), dfd.end ());
+	header.insert (header.end (), kvd.begin (), kvd.end ());
+
+	std::ofstream out (filename, std::ios::binary);
+	out.write (reinterpret_cast<const char *> (header.data ()), header.size ());
+	uint64_t written = header.size ();
+	for (uint32_t l = levelCount; l-- > 0;) {
+		static const char ZEROS[8] = {};
+		out.write (ZEROS, levelOffsets[l] - written);
+		out.write (reinterpret_cast<const char *> (data + dataOffsets[l]), levelLengths[l]);
+		written = levelOffsets[l] + levelLengths[l];
+	}
+	if (!out)
+		throw std::runtime_error ("[Ktx2][writeBC1Cubemap] Cannot write " + filename);
+}
+
+}
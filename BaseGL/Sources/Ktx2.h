@@ -0,0 +1,45 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+/// Minimal reader and writer of KTX2 files holding block-compressed cube maps with their mip chain,
+/// without supercompression. The level data is stored from the smallest level to the largest, as recommended,
+/// and each level holds its six faces one after the other, in the +X, -X, +Y, -Y, +Z, -Z order.
+namespace Ktx2 {
+
+/// Vulkan format of 8x4 bits BC1 blocks, without alpha
+const uint32_t VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+
+/// Location of a mip level in the file
+struct Level {
+	uint64_t offset = 0;
+	uint64_t length = 0;
+};
+
+struct Header {
+	uint32_t vkFormat = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t faceCount = 0;
+	std::map<std::string, std::string> keyValues; ///< Metadata, e.g. "KTXwriter"
+	std::vector<Level> levels; ///< Finest level first
+};
+
+/// Reads the header, metadata and level index. Returns false if the file is missing or is not a KTX2 file.
+bool readHeader (const std::string & filename, Header & header);
+
+/// Reads the data of all levels, finest first, into a buffer of (at least) the sum of their lengths
+void readLevels (const std::string & filename, const Header & header, unsigned char * data);
+
+/// Writes a BC1 cube map of the given size. data holds the levels of the given lengths one after the other, finest first,
+/// as readLevels returns them.
+void writeBC1Cubemap (const std::string & filename, uint32_t size, const std::vector<uint64_t> & levelLengths,
+                      const std::map<std::string, std::string> & keyValues, const unsigned char * data);
+
+}
+
+#endif // KTX2_H
@@ -20,6 +20,11 @@
 #include <memory>
 #include <algorithm>
 #include <exception>
+#include <functional>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -30,19 +35,34 @@
 #include "Camera.h"
 #include "Mesh.h"
 #include "MeshLoader.h"
-#include "Sampling.cpp"
-#include "Texture.cpp"
+#include "RenderTarget.h"
+#include "FrameGraph.h"
+#include "Profiler.h"
+#include "Trace.h"
+#include "Headless.h"
+#include "Environment.h"
+#include "EnvironmentLibrary.h"
+#include "ThreadPool.h"
+#include "Sampling.h"
+#include "BlueNoise.h"
+#include "CpuReference.h"
 #include "Render.cpp"
 
 static const std::string SHADER_PATH ("Resources/Shaders/");
-static const std::vector<std::string> SKYBOX_TEXTURE = {
-    "Resources/skybox/right.jpg",
-    "Resources/skybox/left.jpg",
-    "Resources/skybox/top.jpg",
-    "Resources/skybox/bottom.jpg",
-    "Resources/skybox/back.jpg",
-    "Resources/skybox/front.jpg",
-};
+static const std::string DEFAULT_SKY ("Resources/skybox");
+// Faces of a sky directory, in the order of startCubemap
+static const std::vector<std::string> SKY_FACES = { "right.jpg", "left.jpg", "top.jpg", "bottom.jpg", "back.jpg", "front.jpg" };
+// GPU memory of the skies kept resident for switching (a 2048x2048 sky takes 18 MB in BC1)
+static const size_t DEFAULT_SKY_BUDGET = size_t (256) << 20;
+// Blue-noise tiles of the SSDO, computed once and cached in this directory
+static const std::string NOISE_CACHE_PATH ("Resources/");
+// Export of the pass timings (Shift+G)
+static const std::string TIMINGS_FILENAME ("timings.csv");
+// Chrome trace of the CPU and GPU work (J, or --trace=<frames> from the start of the program)
+static const std::string TRACE_FILENAME ("trace.json");
+static const int TRACE_FRAMES = 8;
+
+static const std::string DEFAULT_OUTPUT_PREFIX ("frame_");
 
 static const std::string DEFAULT_MESH_FILENAME ("Resources/Models/face.off");
 
@@ -51,6 +71,12 @@ using namespace std;
 // Window parameters
 static GLFWwindow * windowPtr = nullptr;
 
+// Context and resolution of the headless mode, which has no window (windowPtr stays null)
+static std::shared_ptr<Headless::Context> headlessPtr;
+static int headlessWidth = 0, headlessHeight = 0;
+// Headless on the CPU (--cpu): no OpenGL context either, the frames are rendered by CpuReference
+static bool cpuRendering = false;
+
 // Pointer to the current camera model
 static std::shared_ptr<Camera> cameraPtr;
 
@@ -62,16 +88,123 @@ static std::shared_ptr<ShaderProgram>
     geometryShader,
     lightingShader,
     directShader,
-    directBlurShader,
     indirectShader,
-    indirectBlurShader,
-    mixerShader,
-    skyboxShader;
+    ssdoShader,
+    deinterleaveShader,
+    ssdoLayersShader,
+    reinterleaveShader,
+    pyramidShader,
+    temporalShader,
+    blurShader,
+    downsampleShader,
+    upsampleShader;
+
+// Final composition, specialized for each view mode (number keys)
+static const int VIEW_MODES = 10;
+static std::shared_ptr<ShaderProgram> compositeShaders[VIEW_MODES];
+
+// Screen-sized render targets of the pipeline
+static std::shared_ptr<RenderTargetManager> renderTargetsPtr;
+
+// Passes of the pipeline
+static std::shared_ptr<FrameGraph> frameGraphPtr;
+
+// GPU time of each pass and CPU time of the frames, over the last frames rendered
+static std::shared_ptr<Profiler> profilerPtr;
 
 int draw_buffer = 8;
 
+// Whether the geometry pass rasterizes the mesh as lines (F1). The screen-space passes still fill their quads.
+static bool wireframe = false;
+
+// SSDO resolution divider: 1 for full resolution, 2 for half, 4 for quarter
+static int ssdoFactor = 1;
+
+// Whether the direct and indirect SSDO run as a single pass, or as the original separate passes (for reference)
+static bool fusedSsdo = true;
+
+// Deinterleaved mode: the fused SSDO runs on 16 quarter-resolution layers of the G-buffer, one per rotation of the
+// 4x4 interleaved noise tile, so that the samples of neighboring pixels stay close in the texture cache
+static bool deinterleavedSsdo = false;
+
+// Adaptive sampling: the fused SSDO pass spends fewer samples on small projected kernels and unoccluded regions
+static bool adaptiveSsdo = false;
+
+// Sky seen by the unoccluded SSDO samples: the raw skybox, a cone-filtered lookup in the prefiltered environment,
+// or the spherical harmonics projection of the environment (see skyRadiance in ssdo.fs)
+enum SkyLookup { SKY_RAW, SKY_CONE, SKY_SH };
+static const char * SKY_LOOKUP_NAMES[] = { "raw skybox", "cone-filtered environment", "spherical harmonics" };
+static int skyLookup = SKY_CONE;
+
+// View-space radius of the SSDO kernel
+static float ssdoRadius = 1.f;
+
+// Sequence of the SSDO kernel samples (N to cycle). The low-discrepancy kernels are cosine-weighted.
+// The kernel size is 64 (the size of the sample arrays of the shaders), except in the convergence harness.
+static Sampling::Sequence kernelSequence = Sampling::SOBOL;
+static int kernelSize = 64;
+
+// Blue-noise tile rotating the kernel around the normal (R), and picking the kernel subset of the temporal mode (G),
+// NOISE_SIZE texels wide: 64 (RG8) or 128 (RG16). The deinterleaved SSDO uses a 4x4 tile, one rotation per layer.
+static const int NOISE_SIZE = 64;
+static std::vector<float> noiseRotations; // of the NOISE_SIZE tile, as the shaders sample them, for the CPU reference
+
+// Point light of the Phong shading, in world space
+static const glm::vec4 LIGHT_POSITION (0.f, 0.f, 5.f, 1.f);
+static const glm::vec3 LIGHT_COLOR (.8f, .8f, .6f);
+static const float LIGHT_LINEAR = 0.09f;
+static const float LIGHT_QUADRATIC = 0.032f;
+
+// The fused SSDO pass can fetch far samples from a min/max depth pyramid rather than the full resolution depth,
+// and march towards each sample over it (MARCH_STEPS points) instead of testing the sample only
+static bool usePyramid = false;
+static bool horizonMarching = false;
+static const int MARCH_STEPS = 4;
+
+// Temporal mode: the fused SSDO pass evaluates 64 / TEMPORAL_FRAMES samples per frame, a different subset each frame,
+// and the results are accumulated in history targets reprojected to the current view. Once the view stops changing,
+// the accumulation restarts, so that the next TEMPORAL_FRAMES frames average each subset exactly once.
+static bool temporalSsdo = false;
+static const int TEMPORAL_FRAMES = 8;
+static unsigned int temporalPhase = 0; // subset of the kernel used this frame
+static bool historyValid = false; // whether the history targets hold the previous frame
+static bool historyWritten = false; // whether the temporal pass ran this frame (it is culled by some view modes)
+static const char * HISTORY_TARGETS[] = { "ssdoHistory", "ssdoIndirectHistory", "depthHistory", "normalHistory" };
+static const char * ACCUM_TARGETS[] = { "ssdoAccum", "ssdoIndirectAccum", "depthAccum", "normalAccum" };
+
+// Edge-aware blur of the SSDO results. The spatial sigma is in pixels, the depth sigma relative to the view depth,
+// and the normal power sharpens the falloff across creases. The radius is at most MAX_RADIUS in blur.cs.
+static struct {
+    int radius = 4;
+    float spatialSigma = 2.f;
+    float depthSigma = 0.1f;
+    float normalPower = 16.f;
+} blurSettings;
+static const int BLUR_TILE = 128; // Workgroup size of blur.cs
+static const int BLUR_MAX_RADIUS = 16;
+
+// Incremented whenever a render parameter (view mode, render target size) changes. Together with
+// the revisions of the camera and the mesh, tells whether the last frame is still up to date.
+static unsigned int paramsRevision = 0;
+
+// Window resizes are applied to the render targets once the size has been stable for this long (in seconds),
+// so that dragging the window border does not reallocate every frame. Meanwhile the last targets are stretched.
+static const double RESIZE_DELAY = 0.2;
+static bool resizePending (false);
+static double resizeTime (0.0);
+
+// While skies load in the background, the idle loop wakes up this often (in seconds) to upload them
+static const double SKY_POLL_DELAY = 0.05;
+
+// Skies to switch between (E), from the command line. The first one is decoded while the shaders compile and the mesh loads.
+static std::vector<std::string> skyDirectories = { DEFAULT_SKY };
+static size_t skyBudget = DEFAULT_SKY_BUDGET;
+static std::shared_ptr<EnvironmentLibrary> environmentsPtr;
+
 // Camera control variables
 static float meshScale = 1.0; // To update based on the mesh size, so that navigation runs at scale
+static glm::vec3 meshCenter (0.0); // Bounding sphere of the mesh, in object space
+static float meshRadius = 0.f;
 static bool isRotating (false);
 static bool isPanning (false);
 static bool isZooming (false);
@@ -89,7 +222,22 @@ ostream& operator<<(ostream& os, const glm::mat4 m) {
     return os << endl;
 }
 
+// Size of the framebuffer the frames are rendered for: the window's, or the headless resolution
+void framebufferSize (int & width, int & height) {
+	if (headlessWidth > 0) {
+		width = headlessWidth;
+		height = headlessHeight;
+	} else
+		glfwGetFramebufferSize (windowPtr, &width, &height);
+}
+
 void clear ();
+void setSsdoResolution (int factor);
+void compareSsdoReference ();
+void compareCpuReference ();
+void printSsdoRadiusStats ();
+void printKernelConvergence ();
+void uploadKernel (uint32_t seed);
 
 void printHelp () {
 	std::cout << "> Help:" << std::endl
@@ -100,16 +248,93 @@ void printHelp () {
 			  << "    Keyboard commands:" << std::endl
    			  << "    * H: print this help" << std::endl
    			  << "    * F1: toggle wireframe rendering" << std::endl
+   			  << "    * R: cycle the SSDO resolution (full, half, quarter)" << std::endl
+   			  << "    * [/]: decrease/increase the SSDO blur radius" << std::endl
+   			  << "    * F: toggle between the fused and the separate direct/indirect SSDO passes" << std::endl
+   			  << "    * I: toggle the deinterleaved (cache-coherent) fused SSDO" << std::endl
+   			  << "    * -/=: halve/double the SSDO radius" << std::endl
+   			  << "    * P: toggle the depth pyramid for the fused SSDO samples" << std::endl
+   			  << "    * M: toggle horizon marching for the fused SSDO samples" << std::endl
+   			  << "    * S: print the SSDO quality and GPU time of the pyramid and marching per radius" << std::endl
+   			  << "    * A: toggle adaptive sampling for the fused SSDO" << std::endl
+   			  << "    * E/Shift+E: switch to the next/previous sky of the command line" << std::endl
+   			  << "    * N: cycle the SSDO kernel sequence (random, Hammersley, Halton, Sobol)" << std::endl
+   			  << "    * Shift+N: print the convergence of each kernel sequence against 4096 samples" << std::endl
+   			  << "    * G: print the mean and percentiles of the GPU time of each pass and of the CPU frame time" << std::endl
+   			  << "    * Shift+G: write the same timings to " << TIMINGS_FILENAME << std::endl
+   			  << "    * J: record the next " << TRACE_FRAMES << " frames to " << TRACE_FILENAME << " (chrome://tracing)" << std::endl
+   			  << "    * K: cycle the SSDO sky lookup (raw skybox, cone-filtered environment, spherical harmonics)" << std::endl
+   			  << "    * T: toggle the temporal accumulation of the SSDO" << std::endl
+   			  << "    * C: compare the SSDO settings with full resolution fused passes (GPU time, image difference)" << std::endl
+   			  << "    * V: render the current view with the CPU reference, and compare it with the GPU (throughput, image difference)" << std::endl
+   			  << "    * 0-9: view mode (0 normals, 1 lighting, 2-3 direct SSDO, 4-5 indirect SSDO, 6 depth, 7 skybox, 8 final, 9 SSDO sample count)" << std::endl
    			  << "    * ESC: quit the program" << std::endl;
 }
 
-// Executed each time the window is resized. Adjust the aspect ratio and the rendering viewport to the current window. 
+// Executed each time the window is resized. Adjust the aspect ratio, and schedule the reallocation of the render targets.
 void windowSizeCallback (GLFWwindow * windowPtr, int width, int height) {
-    return; // NOT supported
+    if (width == 0 || height == 0) return; // minimized
 	cameraPtr->setAspectRatio (static_cast<float>(width) / static_cast<float>(height));
-	glViewport (0, 0, (GLint)width, (GLint)height); // Dimension of the rendering region in the window
-	// ssaoShader->set("windowSize", glm::vec2(width, height));
-    // TODO resize VBO :(
+    resizePending = true;
+    resizeTime = glfwGetTime ();
+}
+
+// Reallocates the render targets to the framebuffer size, once the window stopped being resized
+void applyPendingResize () {
+    if (!resizePending || glfwGetTime () - resizeTime < RESIZE_DELAY)
+        return;
+    int width, height;
+    glfwGetFramebufferSize (windowPtr, &width, &height);
+    if (width > 0 && height > 0)
+        renderTargetsPtr->resize (width, height);
+    resizePending = false;
+    historyValid = false;
+    paramsRevision++;
+}
+
+// Copies the last composited frame to the window, stretched if the window was resized since.
+// Headless, there is no window: the frames are read back from the composite target.
+void present () {
+    if (headlessPtr)
+        return;
+    int width, height;
+    glfwGetFramebufferSize (windowPtr, &width, &height);
+    const RenderTargetDesc & desc = renderTargetsPtr->target("composite").desc();
+    glBlitNamedFramebuffer(renderTargetsPtr->framebuffer({"composite"}), 0,
+                           0, 0, desc.width, desc.height, 0, 0, width, height,
+                           GL_COLOR_BUFFER_BIT, GL_LINEAR);
+}
+
+// Executed when the window content is damaged (e.g., uncovered), while the scene did not change
+void windowRefreshCallback (GLFWwindow * windowPtr) {
+    if (!renderTargetsPtr) return;
+    present ();
+    glfwSwapBuffers (windowPtr);
+}
+
+// Whether the scene or the render parameters changed since the last rendered frame,
+// or the temporal accumulation still has to go through the whole kernel since the view stopped changing
+bool needsRedraw () {
+    static unsigned int lastCamera = 0, lastMesh = 0, lastParams = 0;
+    static bool first = true;
+    static int accumulating = 0;
+    bool changed = first
+        || cameraPtr->revision () != lastCamera
+        || meshPtr->revision () != lastMesh
+        || paramsRevision != lastParams;
+    first = false;
+    lastCamera = cameraPtr->revision ();
+    lastMesh = meshPtr->revision ();
+    lastParams = paramsRevision;
+    if (changed)
+        accumulating = temporalSsdo ? TEMPORAL_FRAMES : 0;
+    else if (accumulating > 0) {
+        if (accumulating == TEMPORAL_FRAMES) // the history weighs the frames in motion: the mean restarts from the still view
+            historyValid = false;
+        accumulating--;
+        return true;
+    }
+    return changed;
 }
 
 /// Executed each time a key is entered.
@@ -119,14 +344,105 @@ void keyCallback (GLFWwindow * windowPtr, int key, int scancode, int action, int
             glfwSetWindowShouldClose (windowPtr, true);
         else if (key == GLFW_KEY_H)
             printHelp();
-        else if (key >= GLFW_KEY_0 && key <= GLFW_KEY_9)
+        else if (key == GLFW_KEY_R) {
+            setSsdoResolution (ssdoFactor == 4 ? 1 : 2 * ssdoFactor);
+            std::cout << "> SSDO at 1/" << ssdoFactor << " resolution" << std::endl;
+        }
+        else if (key == GLFW_KEY_C)
+            compareSsdoReference ();
+        else if (key == GLFW_KEY_V)
+            compareCpuReference ();
+        else if (key == GLFW_KEY_I) {
+            deinterleavedSsdo = !deinterleavedSsdo;
+            setSsdoResolution (ssdoFactor);
+            std::cout << "> Deinterleaved SSDO " << (deinterleavedSsdo ? "on" : "off")
+                      << (fusedSsdo ? "" : " (applies to the fused passes only)") << std::endl;
+        }
+        else if (key == GLFW_KEY_MINUS || key == GLFW_KEY_EQUAL) {
+            ssdoRadius *= key == GLFW_KEY_MINUS ? 0.5f : 2.f;
+            std::cout << "> SSDO radius " << ssdoRadius << std::endl;
+            paramsRevision++;
+        }
+        else if (key == GLFW_KEY_P) {
+            usePyramid = !usePyramid;
+            setSsdoResolution (ssdoFactor);
+            std::cout << "> SSDO depth pyramid " << (usePyramid ? "on" : "off") << std::endl;
+        }
+        else if (key == GLFW_KEY_M) {
+            horizonMarching = !horizonMarching;
+            paramsRevision++;
+            std::cout << "> SSDO horizon marching " << (horizonMarching ? "on" : "off") << std::endl;
+        }
+        else if (key == GLFW_KEY_A) {
+            adaptiveSsdo = !adaptiveSsdo;
+            paramsRevision++;
+            std::cout << "> Adaptive SSDO sampling " << (adaptiveSsdo ? "on" : "off") << std::endl;
+        }
+        else if (key == GLFW_KEY_K) {
+            skyLookup = (skyLookup + 1) % 3;
+            paramsRevision++;
+            std::cout << "> SSDO sky lookup: " << SKY_LOOKUP_NAMES[skyLookup] << std::endl;
+        }
+        else if (key == GLFW_KEY_S)
+            printSsdoRadiusStats ();
+        else if (key == GLFW_KEY_J) {
+            Trace::start (TRACE_FILENAME, TRACE_FRAMES);
+            std::cout << "> Tracing " << TRACE_FRAMES << " frames" << std::endl;
+        }
+        else if (key == GLFW_KEY_G) {
+            profilerPtr->poll ();
+            if (!(mods & GLFW_MOD_SHIFT))
+                profilerPtr->print (std::cout);
+            else if (profilerPtr->writeCsv (TIMINGS_FILENAME))
+                std::cout << "> Timings written to " << TIMINGS_FILENAME << std::endl;
+            else
+                std::cout << "> Cannot write " << TIMINGS_FILENAME << std::endl;
+        }
+        else if (key == GLFW_KEY_N && (mods & GLFW_MOD_SHIFT))
+            printKernelConvergence ();
+        else if (key == GLFW_KEY_N) {
+            kernelSequence = static_cast<Sampling::Sequence> ((kernelSequence + 1) % Sampling::SEQUENCES);
+            uploadKernel (0);
+            historyValid = false;
+            paramsRevision++;
+            std::cout << "> SSDO kernel: " << Sampling::name (kernelSequence) << std::endl;
+        }
+        else if (key == GLFW_KEY_E) {
+            int count = environmentsPtr->size ();
+            int sky = (environmentsPtr->requested () + ((mods & GLFW_MOD_SHIFT) ? count - 1 : 1)) % count;
+            try {
+                environmentsPtr->request (sky);
+                std::cout << "> Sky " << environmentsPtr->name (sky) << std::endl;
+            } catch (std::exception & e) {
+                std::cout << "> Cannot load the sky " << environmentsPtr->name (sky) << ": " << e.what () << std::endl;
+            }
+        }
+        else if (key == GLFW_KEY_T) {
+            temporalSsdo = !temporalSsdo;
+            setSsdoResolution (ssdoFactor);
+            std::cout << "> Temporal SSDO " << (temporalSsdo ? "on" : "off") << std::endl;
+        }
+        else if (key == GLFW_KEY_F) {
+            fusedSsdo = !fusedSsdo;
+            setSsdoResolution (ssdoFactor);
+            std::cout << "> " << (fusedSsdo ? "Fused" : "Separate") << " SSDO passes" << std::endl;
+        }
+        else if (key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) {
+            int radius = blurSettings.radius + (key == GLFW_KEY_LEFT_BRACKET ? -1 : 1);
+            blurSettings.radius = std::max (0, std::min (radius, BLUR_MAX_RADIUS));
+            blurSettings.spatialSigma = std::max (0.5f, 0.5f * blurSettings.radius);
+            std::cout << "> SSDO blur radius " << blurSettings.radius << std::endl;
+            paramsRevision++;
+        }
+        else if (key >= GLFW_KEY_0 && key <= GLFW_KEY_9) {
             draw_buffer = key - GLFW_KEY_0;
+            paramsRevision++;
+        }
+        else if (key == GLFW_KEY_F1) {
+            wireframe = !wireframe;
+            paramsRevision++;
+        }
     }
-	else if (action == GLFW_PRESS && key == GLFW_KEY_F1) {
-		GLint mode[2];
-		glGetIntegerv (GL_POLYGON_MODE, mode);
-		glPolygonMode (GL_FRONT_AND_BACK, mode[1] == GL_FILL ? GL_LINE : GL_FILL);
-	}
 }
 
 /// Called each time the mouse cursor moves
@@ -202,11 +518,22 @@ void initGLFW () {
 
 	/// Connect the callbacks for interactive control 
 	glfwSetWindowSizeCallback (windowPtr, windowSizeCallback);
+	glfwSetWindowRefreshCallback (windowPtr, windowRefreshCallback);
 	glfwSetKeyCallback (windowPtr, keyCallback);
 	glfwSetCursorPosCallback(windowPtr, cursorPosCallback);
 	glfwSetMouseButtonCallback (windowPtr, mouseButtonCallback);
 }
 
+// Instead of GLFW, which needs a display: an OpenGL context without window, which renders into the render targets only
+void initHeadless () {
+	try {
+		headlessPtr = std::make_shared<Headless::Context> ();
+	} catch (std::exception & e) {
+		std::cerr << "ERROR: " << e.what () << std::endl;
+		std::exit (EXIT_FAILURE);
+	}
+}
+
 void exitOnCriticalError (const std::string & message) {
 	std::cerr << "> [Critical error]" << message << std::endl;
 	std::cerr << "> [Clearing resources]" << std::endl;
@@ -215,24 +542,99 @@ void exitOnCriticalError (const std::string & message) {
 	std::exit (EXIT_FAILURE);
 }
 
-GLuint gBuffer, gPositionDepth, gNormal, gAlbedo, noiseTex, skyboxMap,
-       ssdoFBO, ssdoBlurFBO, ssdoLightingFBO, ssdoIndirectFBO, ssdoIndirectBlurFBO, skyboxFBO,
-       ssdoTex, ssdoBlurTex, ssdoLightingTex, ssdoIndirectTex, ssdoIndirectBlurTex, skyboxTex;
+// Workers for the CPU side of loading (e.g., image decoding), which overlaps the rest of the initialization
+static std::shared_ptr<ThreadPool> threadPoolPtr;
+
+GLuint noiseTex, interleavedNoiseTex, skyboxMap; // the cube map of the current sky, owned by the library
+static std::shared_ptr<Environment> environmentPtr; // sky lighting of the SSDO, precomputed from the current sky
+
+// Generates the SSDO kernel of the current sequence and size, and sends it to the SSDO shaders
+void uploadKernel (uint32_t seed) {
+    auto kernel = Sampling::generateKernel(kernelSize, kernelSequence, seed);
+    for (auto shader: {directShader, indirectShader, ssdoShader, ssdoLayersShader}) {
+        shader->use();
+        shader->set("samples", kernel);
+        if (shader != indirectShader)
+            shader->set("cosineKernel", Sampling::cosineWeighted(kernelSequence) ? 1 : 0);
+    }
+}
+
+// First channel of a blue-noise tile, the rotations of the kernel, as createNoiseTexture stores them and the shaders read them
+std::vector<float> rotationTexels (const std::vector<uint16_t> & ranks, int size) {
+    const uint32_t pixels = size * size;
+    std::vector<float> texels;
+    for (size_t i = 0; i < ranks.size(); i += 2)
+        texels.push_back(pixels > 64 * 64 ? static_cast<uint16_t> ((uint64_t (ranks[i]) * 65536 + 32768) / pixels) / 65535.f
+                                          : static_cast<uint8_t> (uint32_t (ranks[i]) * 256 / pixels) / 255.f);
+    return texels;
+}
+
+// Uploads a blue-noise tile, its ranks mapped to [0, 1): on 8 bits up to 64x64 (16 ranks per value), on 16 bits beyond
+GLuint createNoiseTexture (BlueNoise::PendingTile & pending) {
+    std::vector<uint16_t> ranks = BlueNoise::finishTile(pending);
+    if (pending.size == NOISE_SIZE)
+        noiseRotations = rotationTexels(ranks, pending.size);
+    const uint32_t pixels = pending.size * pending.size;
+    const bool wide = pixels > 64 * 64;
+    std::vector<uint8_t> texels8;
+    std::vector<uint16_t> texels16;
+    for (uint16_t rank: ranks) {
+        if (wide)
+            texels16.push_back(static_cast<uint16_t> ((uint64_t (rank) * 65536 + 32768) / pixels));
+        else
+            texels8.push_back(static_cast<uint8_t> (uint32_t (rank) * 256 / pixels));
+    }
+    GLuint texture;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureStorage2D(texture, 1, wide ? GL_RG16 : GL_RG8, pending.size, pending.size);
+    glTextureSubImage2D(texture, 0, 0, 0, pending.size, pending.size, GL_RG, wide ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE,
+                        wide ? static_cast<const void *> (texels16.data()) : static_cast<const void *> (texels8.data()));
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    return texture;
+}
 
 void initOpenGL () {
 	// Load extensions for modern OpenGL
-	if (!gladLoadGLLoader ((GLADloadproc)glfwGetProcAddress)) 
+	if (!gladLoadGLLoader (headlessPtr ? (GLADloadproc)Headless::Context::getProcAddress : (GLADloadproc)glfwGetProcAddress))
 		exitOnCriticalError ("[Failed to initialize OpenGL context]");
 
 	glEnable (GL_DEBUG_OUTPUT); // Modern error callback functionnality
 	glEnable (GL_DEBUG_OUTPUT_SYNCHRONOUS); // For recovering the line where the error occurs, set a debugger breakpoint in DebugMessageCallback
     glDebugMessageCallback (debugMessageCallback, 0); // Specifies the function to call when an error message is generated.
+	// Not the debug groups of the trace
+	glDebugMessageControl (GL_DONT_CARE, GL_DEBUG_TYPE_PUSH_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+	glDebugMessageControl (GL_DONT_CARE, GL_DEBUG_TYPE_POP_GROUP, GL_DONT_CARE, 0, nullptr, GL_FALSE);
 	glCullFace (GL_BACK);     // Specifies the faces to cull (here the ones pointing away from the camera)
 	glEnable (GL_CULL_FACE); // Enables face culling (based on the orientation defined by the CW/CCW enumeration).
 	glDepthFunc (GL_LESS); // Specify the depth test for the z-buffer
 	glEnable (GL_DEPTH_TEST); // Enable the z-buffer test in the rasterization
 	glClearColor (0.2f, 0.2f, 0.2f, 1.0f); // specify the background color, used any time the framebuffer is cleared
 	glClearDepthf(1); // specify the background color, used any time the framebuffer is cleared
+	glEnable (GL_TEXTURE_CUBE_MAP_SEAMLESS); // Filter across the cube map faces, for the coarse prefiltered levels
+	try {
+		std::vector<std::vector<std::string>> skies;
+		for (const auto & directory : skyDirectories) {
+			skies.emplace_back ();
+			for (const auto & face : SKY_FACES)
+				skies.back ().push_back (directory + "/" + face);
+		}
+		environmentsPtr = std::make_shared<EnvironmentLibrary> (*threadPoolPtr, skies, skyBudget);
+		environmentsPtr->request (0);
+	} catch (std::exception & e) {
+		exitOnCriticalError (std::string ("[Error loading skybox]") + e.what ());
+	}
+	// Blue noise computed on the workers while the shaders compile, unless cached
+	BlueNoise::PendingTile noiseTile, interleavedNoiseTile;
+	try {
+		const std::string cache = NOISE_CACHE_PATH + "bluenoise" + std::to_string (NOISE_SIZE) + ".noise";
+		noiseTile = BlueNoise::startTile (*threadPoolPtr, NOISE_SIZE, 2, cache);
+		interleavedNoiseTile = BlueNoise::startTile (*threadPoolPtr, 4, 2, NOISE_CACHE_PATH + "bluenoise4.noise");
+	} catch (std::exception & e) {
+		exitOnCriticalError (std::string ("[Error computing the blue noise]") + e.what ());
+	}
 	// Loads and compile the programmable shader pipeline
 	try {
         bool DEBUG = true;
@@ -248,164 +650,154 @@ void initOpenGL () {
             (SHADER_PATH + "pass.vs",
              SHADER_PATH + "direct.fs");
         if (DEBUG) cout << "direct OK\n";
-		directBlurShader = ShaderProgram::genBasicShaderProgram
-            (SHADER_PATH + "pass.vs",
-             SHADER_PATH + "blur.fs");
-        if (DEBUG) cout << "blur OK\n";
 		indirectShader = ShaderProgram::genBasicShaderProgram
             (SHADER_PATH + "pass.vs",
              SHADER_PATH + "indirect.fs");
         if (DEBUG) cout << "indirect OK\n";
-		indirectBlurShader = ShaderProgram::genBasicShaderProgram
+		ssdoShader = ShaderProgram::genBasicShaderProgram
+            (SHADER_PATH + "pass.vs",
+             SHADER_PATH + "ssdo.fs");
+        if (DEBUG) cout << "ssdo OK\n";
+		deinterleaveShader = ShaderProgram::genComputeShaderProgram
+            (SHADER_PATH + "deinterleave.cs");
+        if (DEBUG) cout << "deinterleave OK\n";
+		ssdoLayersShader = ShaderProgram::genComputeShaderProgram
+            (SHADER_PATH + "ssdo.cs");
+        if (DEBUG) cout << "ssdo layers OK\n";
+		reinterleaveShader = ShaderProgram::genBasicShaderProgram
             (SHADER_PATH + "pass.vs",
-             SHADER_PATH + "blur.fs");
+             SHADER_PATH + "reinterleave.fs");
+        if (DEBUG) cout << "reinterleave OK\n";
+		pyramidShader = ShaderProgram::genComputeShaderProgram
+            (SHADER_PATH + "pyramid.cs");
+        if (DEBUG) cout << "pyramid OK\n";
+		temporalShader = ShaderProgram::genBasicShaderProgram
+            (SHADER_PATH + "pass.vs",
+             SHADER_PATH + "temporal.fs");
+        if (DEBUG) cout << "temporal OK\n";
+		blurShader = ShaderProgram::genComputeShaderProgram
+            (SHADER_PATH + "blur.cs");
         if (DEBUG) cout << "blur OK\n";
-		skyboxShader = ShaderProgram::genBasicShaderProgram
-            (SHADER_PATH + "skybox.vs",
-             SHADER_PATH + "skybox.fs");
-        if (DEBUG) cout << "skybox OK\n";
-		mixerShader = ShaderProgram::genBasicShaderProgram
+        for (int mode = 0; mode < VIEW_MODES; mode++)
+            compositeShaders[mode] = ShaderProgram::genBasicShaderProgram
+                (SHADER_PATH + "pass.vs",
+                 SHADER_PATH + "composite.fs",
+                 "#define MODE " + std::to_string(mode));
+        if (DEBUG) cout << "composite OK\n";
+		downsampleShader = ShaderProgram::genBasicShaderProgram
+            (SHADER_PATH + "pass.vs",
+             SHADER_PATH + "downsample.fs");
+        if (DEBUG) cout << "downsample OK\n";
+		upsampleShader = ShaderProgram::genBasicShaderProgram
             (SHADER_PATH + "pass.vs",
-             SHADER_PATH + "mixer.fs");
-        if (DEBUG) cout << "mixer OK\n";
+             SHADER_PATH + "upsample.fs");
+        if (DEBUG) cout << "upsample OK\n";
 	} catch (std::exception & e) {
 		exitOnCriticalError (std::string ("[Error loading shader program]") + e.what ());
 	}
 
 	int SCR_WIDTH, SCR_HEIGHT;
-	glfwGetWindowSize (windowPtr, &SCR_WIDTH, &SCR_HEIGHT);
+	framebufferSize (SCR_WIDTH, SCR_HEIGHT);
     printf("window size: %d %d\n", SCR_WIDTH, SCR_HEIGHT);
 
-    auto kernel = generateKernel(64);
-    directShader->use();
-    directShader->set("samples", kernel);
-    indirectShader->use();
-    indirectShader->set("samples", kernel);
-
-    auto noise = generateNoise(16);
-    glGenTextures(1, &noiseTex);
-    glBindTexture(GL_TEXTURE_2D, noiseTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, 4, 4, 0, GL_RGB, GL_FLOAT, &noise[0]); // 32 bits
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    uploadKernel(0);
 
-    skyboxMap = loadCubemap(SKYBOX_TEXTURE);
+    try {
+        noiseTex = createNoiseTexture(noiseTile);
+        interleavedNoiseTex = createNoiseTexture(interleavedNoiseTile);
+    } catch (std::exception & e) {
+        exitOnCriticalError (std::string ("[Error computing the blue noise]") + e.what ());
+    }
 
     // samplers
 
     lightingShader->use();
-    lightingShader->set("gPositionDepth", 0);
+    lightingShader->set("gDepth", 0);
     lightingShader->set("gNormal", 1);
-    lightingShader->set("gAlbedo", 2);
     directShader->use();
-    directShader->set("gPositionDepth", 0);
+    directShader->set("gDepth", 0);
     directShader->set("gNormal", 1);
     directShader->set("texNoise", 2);
     directShader->set("skybox", 3);
-    directBlurShader->use();
-    directBlurShader->set("tex", 0);
     indirectShader->use();
-    indirectShader->set("gPositionDepth", 0);
+    indirectShader->set("gDepth", 0);
     indirectShader->set("gNormal", 1);
     indirectShader->set("texNoise", 2);
     indirectShader->set("texLighting", 3);
-    indirectBlurShader->use();
-    indirectBlurShader->set("tex", 0);
-    skyboxShader->use();
-    skyboxShader->set("skybox", 0);
-    mixerShader->use();
-    mixerShader->set("gPositionDepth", 0);
-    mixerShader->set("gNormal", 1);
-    mixerShader->set("ssdo", 2);
-    mixerShader->set("ssdoBlur", 3);
-    mixerShader->set("texLighting", 4);
-    mixerShader->set("texIndirectLight", 5);
-    mixerShader->set("texIndirectLightBlur", 6);
-    mixerShader->set("texSkybox", 7);
-
-    // FBOs
-
-    glGenFramebuffers(1, &gBuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer); // geometry
-        // - Position + linear depth color buffer
-        glGenTextures(1, &gPositionDepth);
-        glBindTexture(GL_TEXTURE_2D, gPositionDepth);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPositionDepth, 0);
-        // - Normal color buffer
-        glGenTextures(1, &gNormal);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
-        // - Albedo color buffer
-        glGenTextures(1, &gAlbedo);
-        glBindTexture(GL_TEXTURE_2D, gAlbedo);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedo, 0);
-        // - Tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-        GLuint attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-        glDrawBuffers(3, attachments);
-        // - Create and attach depth buffer (renderbuffer)
-        GLuint rboDepth;
-        glGenRenderbuffers(1, &rboDepth);
-        glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-        // - Finally check if framebuffer is complete
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "GBuffer Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    GLuint *FBOs[] = {
-        &ssdoFBO,
-        &ssdoBlurFBO,
-        &ssdoLightingFBO,
-        &ssdoIndirectFBO,
-        &ssdoIndirectBlurFBO,
-        &skyboxFBO,
-    };
-    GLuint *Texs[] = {
-        &ssdoTex,
-        &ssdoBlurTex,
-        &ssdoLightingTex,
-        &ssdoIndirectTex,
-        &ssdoIndirectBlurTex,
-        &skyboxTex,
-    };
-    for (int i=0; i<6; i++) {
-        auto FBO = FBOs[i];
-        auto Tex = Texs[i];
-        glGenFramebuffers(1, FBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, *FBO);
-        glGenTextures(1, Tex);
-        glBindTexture(GL_TEXTURE_2D, *Tex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *Tex, 0);
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
+    ssdoShader->use();
+    ssdoShader->set("gDepth", 0);
+    ssdoShader->set("gNormal", 1);
+    ssdoShader->set("texNoise", 2);
+    ssdoShader->set("skybox", 3);
+    ssdoShader->set("texLighting", 4);
+    ssdoShader->set("depthPyramid", 5);
+    pyramidShader->use();
+    pyramidShader->set("gDepth", 0);
+    deinterleaveShader->use();
+    deinterleaveShader->set("gDepth", 0);
+    deinterleaveShader->set("gNormal", 1);
+    ssdoLayersShader->use();
+    ssdoLayersShader->set("depthLayers", 0);
+    ssdoLayersShader->set("normalLayers", 1);
+    ssdoLayersShader->set("texNoise", 2);
+    ssdoLayersShader->set("skybox", 3);
+    ssdoLayersShader->set("texLighting", 4);
+    reinterleaveShader->use();
+    reinterleaveShader->set("directLayers", 0);
+    reinterleaveShader->set("indirectLayers", 1);
+    temporalShader->use();
+    const char * temporalInputs[] = { "ssdoTex", "ssdoIndirectTex", "gDepth", "gNormal",
+                                      "historyDirect", "historyIndirect", "historyDepth", "historyNormal" };
+    for (int i = 0; i < 8; i++)
+        temporalShader->set(temporalInputs[i], i);
+    temporalShader->set("maxFrames", TEMPORAL_FRAMES);
+    temporalShader->set("depthTolerance", 0.02f);
+    temporalShader->set("normalTolerance", 0.9f);
+    blurShader->use();
+    blurShader->set("tex", 0);
+    blurShader->set("gDepth", 1);
+    blurShader->set("gNormal", 2);
+    for (auto & compositeShader: compositeShaders) {
+        compositeShader->use();
+        compositeShader->set("gDepth", 0);
+        compositeShader->set("gNormal", 1);
+        compositeShader->set("ssdo", 2);
+        compositeShader->set("ssdoBlur", 3);
+        compositeShader->set("texLighting", 4);
+        compositeShader->set("texIndirectLight", 5);
+        compositeShader->set("texIndirectLightBlur", 6);
+        compositeShader->set("skybox", 7);
+        compositeShader->set("ssdoSamples", 8);
     }
+    downsampleShader->use();
+    downsampleShader->set("gDepth", 0);
+    downsampleShader->set("gNormal", 1);
+    upsampleShader->use();
+    upsampleShader->set("gDepth", 0);
+    upsampleShader->set("gNormal", 1);
+    upsampleShader->set("lowDepth", 2);
+    upsampleShader->set("lowNormal", 3);
+    upsampleShader->set("tex", 4);
+
+    // Render targets
+
+    renderTargetsPtr = std::make_shared<RenderTargetManager> ();
+    // Nothing outlives the frame: the frame graph aliases the targets with disjoint lifetimes
+    const bool transient = true;
+    // Compact G-buffer: view-space positions are reconstructed from the depth, normals are octahedral-encoded
+    renderTargetsPtr->declare("gNormal", GL_RG16, 1.f, transient);
+    renderTargetsPtr->declare("gDepth", GL_DEPTH_COMPONENT24, 1.f, transient);
+    for (auto name: {"ssdoTex", "ssdoLightingTex", "ssdoIndirectTex"})
+        renderTargetsPtr->declare(name, GL_RGB8, 1.f, transient);
+    // Written by the blur through image stores, for which RGB8 is not a valid format
+    for (auto name: {"ssdoBlurTex", "ssdoIndirectBlurTex"})
+        renderTargetsPtr->declare(name, GL_RGBA8, 1.f, transient);
+    renderTargetsPtr->declare("composite", GL_RGBA8); // kept across frames, to re-present it while idle
+    renderTargetsPtr->resize(SCR_WIDTH, SCR_HEIGHT);
 }
 
-void initScene (const std::string & meshFilename) {
-	// Camera
-	int width, height;
-	glfwGetWindowSize (windowPtr, &width, &height);
-	cameraPtr = std::make_shared<Camera> ();
-	cameraPtr->setAspectRatio (static_cast<float>(width) / static_cast<float>(height));
-	
-	// Mesh
+// Loads the mesh to render, replacing the current one
+void loadMesh (const std::string & meshFilename) {
 	meshPtr = std::make_shared<Mesh> ();
 	try {
 		MeshLoader::loadOFF (meshFilename, meshPtr);
@@ -413,44 +805,638 @@ void initScene (const std::string & meshFilename) {
 		exitOnCriticalError (std::string ("[Error loading mesh]") + e.what ());
 	}
 	meshPtr->standardize();
-	meshPtr->init ();
+	meshPtr->computeBoundingSphere (meshCenter, meshRadius);
+	if (!cpuRendering)
+		meshPtr->init ();
+}
+
+void initScene (const std::string & meshFilename) {
+	// Camera
+	int width, height;
+	framebufferSize (width, height);
+	cameraPtr = std::make_shared<Camera> ();
+	cameraPtr->setAspectRatio (static_cast<float>(width) / static_cast<float>(height));
+	
+	// Mesh
+	loadMesh (meshFilename);
 
 	// Adjust the camera to the actual mesh
 	cameraPtr->setTranslation (glm::vec3 (0.0, 0.0, 3.0 * meshScale));
 	cameraPtr->setNear (meshScale / 100.f);
 	cameraPtr->setFar (6.f * meshScale);
+}
+
+// Renders the current sky of the library, and lights the SSDO with it
+void applySky () {
+    skyboxMap = environmentsPtr->cubemap();
+    environmentPtr = environmentsPtr->environment();
+    for (auto shader: {directShader, ssdoShader, ssdoLayersShader}) {
+        shader->use();
+        shader->set("shRadiance", environmentPtr->sh());
+    }
+    historyValid = false;
+    paramsRevision++;
+}
+
+// Uploads the first sky decoded in the background, and the sky lighting precomputed from it
+void initSkybox () {
+    try {
+        environmentsPtr->wait();
+    } catch (std::exception & e) {
+        exitOnCriticalError (std::string ("[Error loading skybox]") + e.what ());
+    }
+    applySky();
+}
 
-    geometryShader->use();
-    geometryShader->set("NEAR", meshScale / 100);
-    geometryShader->set("FAR", 6 * meshScale);
+// Switches to the requested sky once it is resident, and carries on with the background loading of the others
+void updateSky () {
+    if (environmentsPtr->update())
+        applySky();
+}
+
+void initFrameGraph ();
+
+// CPU mode, without any OpenGL context: the scene, and the sky lighting and kernel rotations of the CPU reference
+void initCpu (const std::string & meshFilename) {
+	threadPoolPtr = std::make_shared<ThreadPool> ();
+	initScene (meshFilename);
+	try {
+		std::vector<std::string> faces;
+		for (const auto & face : SKY_FACES)
+			faces.push_back (skyDirectories[0] + "/" + face);
+		environmentPtr = std::make_shared<Environment> (*threadPoolPtr, faces);
+	} catch (std::exception & e) {
+		exitOnCriticalError (std::string ("[Error loading skybox]") + e.what ());
+	}
+	try {
+		const std::string cache = NOISE_CACHE_PATH + "bluenoise" + std::to_string (NOISE_SIZE) + ".noise";
+		BlueNoise::PendingTile noiseTile = BlueNoise::startTile (*threadPoolPtr, NOISE_SIZE, 2, cache);
+		noiseRotations = rotationTexels (BlueNoise::finishTile (noiseTile), NOISE_SIZE);
+	} catch (std::exception & e) {
+		exitOnCriticalError (std::string ("[Error computing the blue noise]") + e.what ());
+	}
 }
 
 void init (const std::string & meshFilename) {
-	initGLFW (); // Windowing system
-	initOpenGL (); // OpenGL Context and shader pipeline
-	initScene (meshFilename); // Actual scene to render
+	Trace::Scope scope ("init");
+	if (cpuRendering) {
+		initCpu (meshFilename);
+		return;
+	}
+	threadPoolPtr = std::make_shared<ThreadPool> ();
+	if (headlessWidth > 0)
+		initHeadless (); // No windowing system
+	else
+		initGLFW (); // Windowing system
+	{
+		Trace::Scope scope ("initOpenGL");
+		initOpenGL (); // OpenGL Context and shader pipeline
+	}
+	initFrameGraph (); // Passes of the pipeline
+	{
+		Trace::Scope scope ("initScene");
+		initScene (meshFilename); // Actual scene to render
+	}
+	{
+		Trace::Scope scope ("initSkybox");
+		initSkybox (); // Once decoded
+	}
 }
 
 void clear () {
 	cameraPtr.reset ();
 	meshPtr.reset ();
-	geometryShader.reset ();
-	directShader.reset ();
-	glfwDestroyWindow (windowPtr);
-	glfwTerminate ();
+    for (auto shader: {&geometryShader, &lightingShader, &directShader, &indirectShader,
+                       &ssdoShader, &deinterleaveShader, &ssdoLayersShader, &reinterleaveShader,
+                       &pyramidShader, &temporalShader, &blurShader, &downsampleShader, &upsampleShader})
+        shader->reset ();
+    for (auto & shader: compositeShaders)
+        shader.reset ();
+    frameGraphPtr.reset ();
+    profilerPtr.reset ();
+    renderTargetsPtr.reset ();
+    if (noiseTex) glDeleteTextures(1, &noiseTex);
+    if (interleavedNoiseTex) glDeleteTextures(1, &interleavedNoiseTex);
+    environmentPtr.reset ();
+    environmentsPtr.reset ();
+    clearPrimitives ();
+    threadPoolPtr.reset ();
+	if (headlessPtr)
+		headlessPtr.reset ();
+	else {
+		glfwDestroyWindow (windowPtr);
+		glfwTerminate ();
+	}
 }
 
 
-// The main rendering call
-void render () {
-    glm::mat4 projectionMatrix = cameraPtr->computeProjectionMatrix ();
-    glm::mat4 viewMatrix = cameraPtr->computeViewMatrix ();
+// Camera matrices of the frame being rendered, read by the passes
+static glm::mat4 projectionMatrix, viewMatrix;
+static glm::mat4 prevProjectionMatrix, prevViewMatrix; // of the last rendered frame, for the temporal reprojection
+
+// Restricts a pass to the pixels covered by geometry: scissored to the projected bounding sphere of the mesh, within which
+// the shaders discard the background (they sample gDepth, so it cannot also be attached to test a stencil)
+FrameGraph::Pass maskedPass (FrameGraph::Pass pass) {
+    pass.masked = true;
+    return pass;
+}
+
+// Binds a blue-noise tile to unit 2 for the given SSDO shader. The temporal mode offsets its rotations by the golden ratio each frame
+// (an additive recurrence, evenly spread over any number of frames), so that the accumulated frames see different rotations.
+void bindNoise (ShaderProgram & shader, GLuint tile) {
+    const double GOLDEN_RATIO_CONJUGATE = 0.6180339887498949;
+    double offset = temporalSsdo ? temporalPhase * GOLDEN_RATIO_CONJUGATE : 0.0;
+    shader.set("noiseOffset", static_cast<float> (offset - std::floor(offset)));
+    glBindTextureUnit(2, tile);
+}
+
+// Binds the cube map of the sky lookup mode to unit 3, and selects the mode in the given SSDO shader
+void bindSky (ShaderProgram & shader) {
+    shader.set("skyLookup", skyLookup);
+    glBindTextureUnit(3, skyLookup == SKY_RAW ? skyboxMap : environmentPtr->prefiltered());
+}
+
+// Render targets read by the composite pass for each view mode (number keys)
+std::vector<FrameGraph::Input> compositeInputs (int mode) {
+    switch (mode) {
+    case 0: return { {"gNormal", 1} };
+    case 1: return { {"gDepth", 0}, {"ssdoLightingTex", 4} };
+    case 2: return { {"gDepth", 0}, {"ssdoTex", 2} };
+    case 3: return { {"gDepth", 0}, {"ssdoBlurTex", 3} };
+    case 4: return { {"gDepth", 0}, {"ssdoIndirectTex", 5} };
+    case 5: return { {"gDepth", 0}, {"ssdoIndirectBlurTex", 6} };
+    case 6: return { {"gDepth", 0} };
+    case 7: return {};
+    case 9: return { {"gDepth", 0}, {"ssdoSampleCount", 8} };
+    default: return { {"gDepth", 0}, {"ssdoBlurTex", 3}, {"ssdoLightingTex", 4},
+                      {"ssdoIndirectBlurTex", 6} };
+    }
+}
+
+// Accumulate light pass, with the sky of the background. Only reads what the view mode displays.
+// Only the fused fragment SSDO pass counts its samples: otherwise the sample count view shows the final image.
+FrameGraph::Pass compositePass (int mode) {
+    if (mode == 9 && (!fusedSsdo || deinterleavedSsdo))
+        mode = 8;
+    return { "composite", compositeInputs(mode), {"composite"}, "", [mode] {
+        ShaderProgram & shader = *compositeShaders[mode];
+        shader.use();
+        shader.set("projectionMat", projectionMatrix);
+        shader.set("iViewProjectionMat", glm::inverse(projectionMatrix * glm::mat4(glm::mat3(viewMatrix))));
+        glBindTextureUnit(7, skyboxMap);
+        renderQuad(); // covers every pixel: no clear
+    }};
+}
+
+// Separable edge-aware blur of source into destination, through the intermediate target. Depth and normal
+// are the G-buffer at the resolution of source. Each pass dispatches one workgroup per line segment of BLUR_TILE pixels,
+// over the rectangle covered by geometry only.
+void addBlurPasses (const std::string & name, const std::string & source, const std::string & intermediate,
+                    const std::string & destination, const std::string & depth, const std::string & normal) {
+    const std::string passes[2][2] = { {source, intermediate}, {intermediate, destination} };
+    for (int vertical = 0; vertical < 2; vertical++) {
+        const std::string output = passes[vertical][1];
+        FrameGraph::Pass pass = { name + (vertical ? "V" : "H"), {{passes[vertical][0], 0}, {depth, 1}, {normal, 2}},
+                                  {output}, "", [output, vertical] {
+            const RenderTargetDesc & desc = renderTargetsPtr->target(output).desc();
+            FrameGraph::Rect rect = frameGraphPtr->coverage(desc.width, desc.height);
+            GLsizei length = vertical ? rect.height : rect.width;
+            blurShader->use();
+            blurShader->set("direction", glm::ivec2(1 - vertical, vertical));
+            blurShader->set("offset", glm::ivec2(rect.x, rect.y));
+            blurShader->set("radius", blurSettings.radius);
+            blurShader->set("spatialSigma", blurSettings.spatialSigma);
+            blurShader->set("depthSigma", blurSettings.depthSigma);
+            blurShader->set("normalPower", blurSettings.normalPower);
+            blurShader->set("projectionMat", projectionMatrix);
+            if (rect.width > 0 && rect.height > 0)
+                glDispatchCompute((length + BLUR_TILE - 1) / BLUR_TILE, vertical ? rect.width : rect.height, 1);
+        }};
+        pass.compute = true;
+        pass.masked = true;
+        frameGraphPtr->addPass(pass);
+    }
+}
+
+// (Re)declares the SSDO targets and passes for the given resolution divider, fused or not. Below full resolution,
+// the SSDO passes run on a downsampled G-buffer, and their blurred results are upsampled for the composite pass.
+void setSsdoResolution (int factor) {
+    ssdoFactor = factor;
+    auto & targets = *renderTargetsPtr;
+    auto & graph = *frameGraphPtr;
+    const bool transient = true;
+    const float scale = 1.f / factor;
+    const bool lowRes = factor > 1;
+    // G-buffer and outputs of the SSDO passes
+    const std::string depth = lowRes ? "gDepthLow" : "gDepth";
+    const std::string normal = lowRes ? "gNormalLow" : "gNormal";
+    const std::string directBlur = lowRes ? "ssdoBlurLowTex" : "ssdoBlurTex";
+    const std::string indirectBlur = lowRes ? "ssdoIndirectBlurLowTex" : "ssdoIndirectBlurTex";
+
+    targets.declare("ssdoTex", GL_RGB8, scale, transient);
+    targets.declare("ssdoIndirectTex", GL_RGB8, scale, transient);
+    targets.declare("ssdoBlurTmp", GL_RGBA8, scale, transient); // horizontally blurred
+    targets.declare("ssdoIndirectBlurTmp", GL_RGBA8, scale, transient);
+    if (lowRes) {
+        targets.declare("gDepthLow", GL_R32F, scale, transient); // raw depth buffer values
+        targets.declare("gNormalLow", GL_RG16, scale, transient);
+        targets.declare("ssdoBlurLowTex", GL_RGBA8, scale, transient);
+        targets.declare("ssdoIndirectBlurLowTex", GL_RGBA8, scale, transient);
+
+        graph.addPass(maskedPass({ "downsample", {{"gDepth", 0}, {"gNormal", 1}}, {"gDepthLow", "gNormalLow"}, "", [factor] {
+            downsampleShader->use();
+            downsampleShader->set("factor", factor);
+            renderQuad();
+        }}));
+        for (auto blur: {"ssdoBlur", "ssdoIndirectBlur"}) {
+            std::string name = blur == std::string("ssdoBlur") ? "directUpsample" : "indirectUpsample";
+            graph.addPass(maskedPass({ name, {{"gDepth", 0}, {"gNormal", 1}, {"gDepthLow", 2}, {"gNormalLow", 3}, {blur + std::string("LowTex"), 4}},
+                                       {blur + std::string("Tex")}, "", [] {
+                upsampleShader->use();
+                upsampleShader->set("projectionMat", projectionMatrix);
+                renderQuad();
+            }}));
+        }
+    } else {
+        for (auto name: {"gDepthLow", "gNormalLow", "ssdoBlurLowTex", "ssdoIndirectBlurLowTex"})
+            targets.remove(name);
+        for (auto name: {"downsample", "directUpsample", "indirectUpsample"})
+            graph.removePass(name);
+    }
+
+    // Kernel subset of this frame: the temporal mode covers the kernel in TEMPORAL_FRAMES frames, one interleaved subset per frame
+    auto setSamples = [] (ShaderProgram & shader) {
+        const int subsets = temporalSsdo ? TEMPORAL_FRAMES : 1;
+        shader.set("sampleCount", kernelSize / subsets);
+        shader.set("sampleOffset", static_cast<int> (temporalPhase % subsets));
+        shader.set("sampleStride", subsets);
+    };
+    const bool deinterleaved = fusedSsdo && deinterleavedSsdo;
+    const bool pyramid = fusedSsdo && !deinterleaved && usePyramid;
+    if (!pyramid) {
+        targets.remove("depthPyramid");
+        graph.removePass("depthPyramid");
+    }
+    const char * layerTargets[] = { "gDepthLayers", "gNormalLayers", "ssdoLayers", "ssdoIndirectLayers" };
+    const char * layerPasses[] = { "deinterleave", "reinterleave" };
+    if (deinterleaved) {
+        const GLenum formats[] = { GL_R32F, GL_RG16, GL_RGBA8, GL_RGBA8 };
+        for (int i = 0; i < 4; i++)
+            targets.declare(layerTargets[i], formats[i], scale / 4, transient, 16);
+    } else {
+        for (auto name: layerTargets)
+            targets.remove(name);
+        for (auto name: layerPasses)
+            graph.removePass(name);
+    }
+
+    if (deinterleaved) {
+        graph.removePass("direct");
+        graph.removePass("indirect");
+        targets.remove("ssdoSampleCount");
+        // G-buffer to 16 layers, one per noise rotation
+        FrameGraph::Pass deinterleave = { "deinterleave", {{depth, 0}, {normal, 1}}, {"gDepthLayers", "gNormalLayers"}, "",
+                                          [depth] {
+            const RenderTargetDesc & desc = renderTargetsPtr->target(depth).desc();
+            deinterleaveShader->use();
+            glDispatchCompute((desc.width + 7) / 8, (desc.height + 7) / 8, 1);
+        }};
+        deinterleave.compute = true;
+        graph.addPass(deinterleave);
+
+        // SSDO Direct + Indirect, on each layer
+        FrameGraph::Pass ssdo = { "ssdo", {{"gDepthLayers", 0}, {"gNormalLayers", 1}, {"ssdoLightingTex", 4}},
+                                  {"ssdoLayers", "ssdoIndirectLayers"}, "", [depth, setSamples] {
+            const RenderTargetDesc & desc = renderTargetsPtr->target(depth).desc();
+            const RenderTargetDesc & layers = renderTargetsPtr->target("ssdoLayers").desc();
+            ssdoLayersShader->use();
+            ssdoLayersShader->set("resolution", glm::ivec2(desc.width, desc.height));
+            ssdoLayersShader->set("projectionMat", projectionMatrix);
+            ssdoLayersShader->set("iProjectionMat", glm::inverse(projectionMatrix));
+            ssdoLayersShader->set("iViewMat", glm::inverse(viewMatrix));
+            ssdoLayersShader->set("radius", ssdoRadius);
+            setSamples(*ssdoLayersShader);
+            bindNoise(*ssdoLayersShader, interleavedNoiseTex);
+            bindSky(*ssdoLayersShader);
+            glDispatchCompute((layers.width + 7) / 8, (layers.height + 7) / 8, layers.layers);
+        }};
+        ssdo.compute = true;
+        graph.addPass(ssdo);
+
+        // Layers back to the SSDO targets
+        graph.addPass({ "reinterleave", {{"ssdoLayers", 0}, {"ssdoIndirectLayers", 1}}, {"ssdoTex", "ssdoIndirectTex"}, "", [] {
+            reinterleaveShader->use();
+            renderQuad();
+        }});
+    } else if (fusedSsdo) {
+        graph.removePass("direct");
+        graph.removePass("indirect");
+        std::vector<FrameGraph::Input> inputs = { {depth, 0}, {normal, 1}, {"ssdoLightingTex", 4} };
+        targets.declare("ssdoSampleCount", GL_R8, scale, transient);
+        if (pyramid) {
+            // Min/max depth pyramid, one compute dispatch per level
+            targets.declare("depthPyramid", GL_RG32F, scale, transient, 1, true);
+            FrameGraph::Pass reduce = { "depthPyramid", {{depth, 0}}, {"depthPyramid"}, "", [] {
+                const RenderTarget & target = renderTargetsPtr->target("depthPyramid");
+                pyramidShader->use();
+                for (GLsizei level = 0; level < target.desc().levels; level++) {
+                    glBindImageTexture(0, target.id(), level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+                    if (level > 0) {
+                        glBindImageTexture(1, target.id(), level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+                        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+                    }
+                    pyramidShader->set("level", static_cast<int> (level));
+                    GLsizei width = std::max(1, target.desc().width >> level), height = std::max(1, target.desc().height >> level);
+                    glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+                }
+            }};
+            reduce.compute = true;
+            graph.addPass(reduce);
+            inputs.push_back({"depthPyramid", 5});
+        }
+        // SSDO Direct + Indirect
+        graph.addPass(maskedPass({ "ssdo", inputs, {"ssdoTex", "ssdoIndirectTex", "ssdoSampleCount"}, "", [setSamples, pyramid] {
+            glClear(GL_COLOR_BUFFER_BIT);
+            ssdoShader->use();
+            ssdoShader->set("projectionMat", projectionMatrix);
+            ssdoShader->set("iProjectionMat", glm::inverse(projectionMatrix));
+            ssdoShader->set("iViewMat", glm::inverse(viewMatrix));
+            ssdoShader->set("radius", ssdoRadius);
+            ssdoShader->set("usePyramid", pyramid ? 1 : 0);
+            ssdoShader->set("maxLevel", pyramid ? renderTargetsPtr->target("depthPyramid").desc().levels - 1 : 0);
+            ssdoShader->set("marchSteps", horizonMarching ? MARCH_STEPS : 0);
+            ssdoShader->set("adaptive", adaptiveSsdo ? 1 : 0);
+            setSamples(*ssdoShader);
+            bindNoise(*ssdoShader, noiseTex);
+            bindSky(*ssdoShader);
+            renderQuad();
+        }}));
+    } else {
+        graph.removePass("ssdo");
+        targets.remove("ssdoSampleCount");
+        // SSDO Direct
+        graph.addPass(maskedPass({ "direct", {{depth, 0}, {normal, 1}}, {"ssdoTex"}, "", [] {
+            glClear(GL_COLOR_BUFFER_BIT);
+            directShader->use();
+            directShader->set ("projectionMat", projectionMatrix);
+            directShader->set ("iProjectionMat", glm::inverse(projectionMatrix));
+            directShader->set ("iViewMat", glm::inverse(viewMatrix));
+            directShader->set ("radius", ssdoRadius);
+            bindNoise(*directShader, noiseTex);
+            bindSky(*directShader);
+            renderQuad();
+        }}));
+
+        // SSDO Indirect
+        graph.addPass(maskedPass({ "indirect", {{depth, 0}, {normal, 1}, {"ssdoLightingTex", 3}}, {"ssdoIndirectTex"}, "", [] {
+            glClear(GL_COLOR_BUFFER_BIT);
+            indirectShader->use();
+            bindNoise(*indirectShader, noiseTex);
+            // Send kernel + rotation 
+            indirectShader->set("projectionMat", projectionMatrix);
+            indirectShader->set("iProjectionMat", glm::inverse(projectionMatrix));
+            indirectShader->set("radius", ssdoRadius);
+            renderQuad();
+        }}));
+    }
+
+    // SSDO Temporal accumulation. The history targets are produced by the previous frame.
+    std::string direct = "ssdoTex", indirect = "ssdoIndirectTex";
+    if (temporalSsdo) {
+        const GLenum formats[] = { GL_RGBA16F, GL_RGBA16F, GL_R32F, GL_RG16 };
+        for (int i = 0; i < 4; i++) {
+            targets.declare(HISTORY_TARGETS[i], formats[i], scale);
+            targets.declare(ACCUM_TARGETS[i], formats[i], scale);
+        }
+        std::vector<FrameGraph::Input> inputs = { {"ssdoTex", 0}, {"ssdoIndirectTex", 1}, {depth, 2}, {normal, 3} };
+        for (GLuint i = 0; i < 4; i++)
+            inputs.push_back({ HISTORY_TARGETS[i], 4 + i });
+        graph.addPass({ "temporal", inputs, std::vector<std::string> (ACCUM_TARGETS, ACCUM_TARGETS + 4), "", [] {
+            temporalShader->use();
+            temporalShader->set("iProjectionMat", glm::inverse(projectionMatrix));
+            temporalShader->set("iViewMat", glm::inverse(viewMatrix));
+            temporalShader->set("prevViewMat", prevViewMatrix);
+            temporalShader->set("prevProjectionMat", prevProjectionMatrix);
+            temporalShader->set("historyValid", historyValid ? 1 : 0);
+            renderQuad();
+            historyWritten = true;
+        }});
+        direct = "ssdoAccum";
+        indirect = "ssdoIndirectAccum";
+    } else {
+        for (int i = 0; i < 4; i++) {
+            targets.remove(HISTORY_TARGETS[i]);
+            targets.remove(ACCUM_TARGETS[i]);
+        }
+        graph.removePass("temporal");
+    }
+    historyValid = false;
+
+    // SSDO Blur
+    addBlurPasses("directBlur", direct, "ssdoBlurTmp", directBlur, depth, normal);
+
+    // SSDO Indirect Blur
+    addBlurPasses("indirectBlur", indirect, "ssdoIndirectBlurTmp", indirectBlur, depth, normal);
+    graph.addPass(compositePass(draw_buffer)); // its inputs depend on the SSDO passes
+    paramsRevision++;
+}
+
+// GPU time of the given commands, in milliseconds. Waits for the result.
+double gpuTime (const std::function<void ()> & commands) {
+    GLuint query;
+    glCreateQueries(GL_TIME_ELAPSED, 1, &query);
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    commands();
+    glEndQuery(GL_TIME_ELAPSED);
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+    glDeleteQueries(1, &query);
+    return ns * 1e-6;
+}
+
+void render ();
+
+// Reads back the last composited image (RGBA)
+void readComposite (std::vector<unsigned char> & image) {
+    const RenderTargetDesc & desc = renderTargetsPtr->target("composite").desc();
+    image.resize(desc.byteSize());
+    glGetTextureImage(renderTargetsPtr->texture("composite"), 0, GL_RGBA, GL_UNSIGNED_BYTE, image.size(), image.data());
+}
+
+// GPU time of a frame, in milliseconds, averaged over a few frames. The last composited image is read back.
+double timeFrames (std::vector<unsigned char> & image) {
+    const int FRAMES = 4;
+    render(); // allocates the targets
+    double time = gpuTime([&] { for (int f = 0; f < FRAMES; f++) render(); }) / FRAMES;
+    readComposite(image);
+    return time;
+}
+
+// Root mean square difference of the color channels of two RGBA images
+template <class A, class B>
+double rmse (const std::vector<A> & a, const std::vector<B> & b) {
+    double squares = 0;
+    size_t count = 0;
+    for (size_t p = 0; p < a.size(); p++) {
+        if (p % 4 == 3) continue; // alpha
+        double d = double(a[p]) - double(b[p]);
+        squares += d * d;
+        count++;
+    }
+    return std::sqrt(squares / count);
+}
+
+double psnr (double rmse) {
+    return 20 * std::log10(255 / std::max(rmse, 1e-3));
+}
+
+// Renders the current view with the reference SSDO (full resolution, fused passes, one frame of 64 samples, raw skybox)
+// and with the current settings, and prints the GPU frame times and the difference between the two final images
+void compareSsdoReference () {
+    const int factor = ssdoFactor;
+    const bool fused = fusedSsdo, deinterleaved = deinterleavedSsdo, temporal = temporalSsdo, pyramid = usePyramid;
+    const bool marching = horizonMarching, adaptive = adaptiveSsdo;
+    const int sky = skyLookup;
+    if (factor == 1 && fused && !deinterleaved && !temporal && !pyramid && !marching && !adaptive && sky == SKY_RAW) {
+        std::cout << "> SSDO uses the reference settings (R, I, P, M, A, K or T to change)" << std::endl;
+        return;
+    }
+    double times[2];
+    std::vector<unsigned char> images[2];
+    for (int i = 0; i < 2; i++) {
+        fusedSsdo = i == 0 || fused;
+        deinterleavedSsdo = i == 1 && deinterleaved;
+        temporalSsdo = i == 1 && temporal;
+        usePyramid = i == 1 && pyramid;
+        horizonMarching = i == 1 && marching;
+        adaptiveSsdo = i == 1 && adaptive;
+        skyLookup = i == 1 ? sky : SKY_RAW;
+        setSsdoResolution(i == 0 ? 1 : factor);
+        times[i] = timeFrames(images[i]);
+    }
+    double error = rmse(images[0], images[1]);
+    std::cout << "> SSDO at 1/" << factor << " resolution" << (fused ? "" : ", separate passes")
+              << (deinterleaved && fused ? ", deinterleaved" : "") << (temporal ? ", temporal" : "")
+              << (pyramid && fused && !deinterleaved ? ", depth pyramid" : "") << (marching && fused ? ", marching" : "")
+              << (adaptive && fused && !deinterleaved ? ", adaptive" : "") << ", " << SKY_LOOKUP_NAMES[sky] << ": "
+              << times[1] << " ms per frame, " << times[0] << " ms for the reference (" << times[0] / times[1] << "x), "
+              << "RMSE " << error << ", PSNR " << psnr(error) << " dB" << std::endl;
+}
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// For a range of SSDO radii, prints the GPU frame time of the fused SSDO with full resolution depth fetches,
+// with the depth pyramid, and with horizon marching over the pyramid, and the PSNR of the last two against the first
+void printSsdoRadiusStats () {
+    const bool deinterleaved = deinterleavedSsdo, temporal = temporalSsdo, pyramid = usePyramid, marching = horizonMarching;
+    const bool fused = fusedSsdo;
+    const float radius = ssdoRadius;
+    fusedSsdo = true;
+    deinterleavedSsdo = temporalSsdo = false;
+    std::cout << "> SSDO radius: full depth ms | pyramid ms, PSNR | pyramid + marching ms, PSNR" << std::endl;
+    for (float r : {0.25f, 0.5f, 1.f, 2.f, 4.f}) {
+        ssdoRadius = r;
+        double times[3];
+        std::vector<unsigned char> images[3];
+        for (int i = 0; i < 3; i++) {
+            usePyramid = i > 0;
+            horizonMarching = i == 2;
+            setSsdoResolution(ssdoFactor);
+            times[i] = timeFrames(images[i]);
+        }
+        std::cout << "    " << r << ": " << times[0] << " | " << times[1] << ", " << psnr(rmse(images[0], images[1]))
+                  << " dB | " << times[2] << ", " << psnr(rmse(images[0], images[2])) << " dB" << std::endl;
+    }
+    fusedSsdo = fused;
+    deinterleavedSsdo = deinterleaved;
+    temporalSsdo = temporal;
+    usePyramid = pyramid;
+    horizonMarching = marching;
+    ssdoRadius = radius;
+    setSsdoResolution(ssdoFactor);
+}
+
+// For each kernel sequence and size from 8 to 64 samples, prints the RMSE of the direct SSDO (view mode 2, before the blur)
+// and of the final image against a reference of 4096 samples: the average of 64 frames of 64 samples, each frame with
+// an independently randomized kernel. The random kernel has its own reference, as its uniform density weights
+// the indirect light differently from the cosine-weighted ones. The errors are averaged over a few seeds.
+void printKernelConvergence () {
+    const int factor = ssdoFactor, mode = draw_buffer, sky = skyLookup;
+    const bool fused = fusedSsdo, deinterleaved = deinterleavedSsdo, temporal = temporalSsdo, pyramid = usePyramid;
+    const bool marching = horizonMarching, adaptive = adaptiveSsdo;
+    const Sampling::Sequence sequence = kernelSequence;
+    const int REFERENCE_FRAMES = 64, SEEDS = 4;
+    const int MODES[2] = { 2, 8 };
+    fusedSsdo = true;
+    deinterleavedSsdo = temporalSsdo = usePyramid = horizonMarching = adaptiveSsdo = false;
+    skyLookup = SKY_RAW; // the same sky for every kernel size
+    setSsdoResolution(1);
+
+    // One view mode after the other, as switching rebuilds the frame graph
+    const int SIZES = 4; // 8 to 64 samples
+    double errors[Sampling::SEQUENCES][SIZES][2] = {};
+    std::vector<unsigned char> image;
+    for (int m = 0; m < 2; m++) {
+        draw_buffer = MODES[m];
+        std::vector<double> references[2]; // uniform, cosine-weighted
+        for (int cosine = 0; cosine < 2; cosine++) {
+            kernelSequence = cosine ? Sampling::SOBOL : Sampling::RANDOM;
+            kernelSize = 64;
+            references[cosine].assign(0, 0.0);
+            for (int frame = 0; frame < REFERENCE_FRAMES; frame++) {
+                uploadKernel(1000 + frame); // seeds of their own
+                render();
+                readComposite(image);
+                references[cosine].resize(image.size());
+                for (size_t p = 0; p < image.size(); p++)
+                    references[cosine][p] += double(image[p]) / REFERENCE_FRAMES;
+            }
+        }
+        for (int s = 0; s < Sampling::SEQUENCES; s++) {
+            kernelSequence = static_cast<Sampling::Sequence> (s);
+            for (int i = 0; i < SIZES; i++) {
+                kernelSize = 8 << i;
+                for (int seed = 1; seed <= SEEDS; seed++) {
+                    uploadKernel(seed);
+                    render();
+                    readComposite(image);
+                    errors[s][i][m] += rmse(image, references[Sampling::cosineWeighted(kernelSequence) ? 1 : 0]) / SEEDS;
+                }
+            }
+        }
+    }
 
-    // Geometry
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    std::cout << "> SSDO kernel RMSE against 4096 samples (direct SSDO | final image), averaged over " << SEEDS << " seeds" << std::endl;
+    for (int s = 0; s < Sampling::SEQUENCES; s++) {
+        std::cout << "    " << Sampling::name(static_cast<Sampling::Sequence> (s)) << ":";
+        for (int i = 0; i < SIZES; i++)
+            std::cout << "  " << (8 << i) << ": " << errors[s][i][0] << " | " << errors[s][i][1];
+        std::cout << std::endl;
+    }
+
+    kernelSequence = sequence;
+    kernelSize = 64;
+    uploadKernel(0);
+    draw_buffer = mode;
+    skyLookup = sky;
+    fusedSsdo = fused;
+    deinterleavedSsdo = deinterleaved;
+    temporalSsdo = temporal;
+    usePyramid = pyramid;
+    horizonMarching = marching;
+    adaptiveSsdo = adaptive;
+    setSsdoResolution(factor);
+}
+
+// Declares the passes of the SSDO pipeline
+void initFrameGraph () {
+    frameGraphPtr = std::make_shared<FrameGraph> (renderTargetsPtr);
+    profilerPtr = std::make_shared<Profiler> ();
+    frameGraphPtr->setProfiler (profilerPtr);
+    auto & graph = *frameGraphPtr;
+
+    graph.addPass({ "geometry", {}, {"gNormal"}, "gDepth", [] {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (wireframe)
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         geometryShader->use();
         geometryShader->set ("projectionMat", projectionMatrix);
         for (auto mesh: {meshPtr}) { // render meshes
@@ -461,121 +1447,265 @@ void render () {
             geometryShader->set ("normalMat", glm::mat3(normalMatrix) );
             mesh->render ();
         }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    }});
 
     // Phong shading
-    glBindFramebuffer(GL_FRAMEBUFFER, ssdoLightingFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    graph.addPass(maskedPass({ "lighting", {{"gDepth", 0}, {"gNormal", 1}}, {"ssdoLightingTex"}, "", [] {
+        glClear(GL_COLOR_BUFFER_BIT);
         lightingShader->use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gPositionDepth);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, gAlbedo);
-        glm::vec4 lightPos = glm::vec4(0,0,5, 1.);
-        glm::vec3 lightColor = {.8, .8, .6};
-        auto lightPosView = glm::vec3(viewMatrix * lightPos);
-        const GLfloat constant = 1.0;
-        const GLfloat linear = 0.09;
-        const GLfloat quadratic = 0.032;
+        lightingShader->set("iProjectionMat", glm::inverse(projectionMatrix));
+        auto lightPosView = glm::vec3(viewMatrix * LIGHT_POSITION);
         lightingShader->set("light.Position", lightPosView);
-        lightingShader->set("light.Color", lightColor);
-        lightingShader->set("light.Linear", linear);
-        lightingShader->set("light.Quadratic", quadratic);
+        lightingShader->set("light.Color", LIGHT_COLOR);
+        lightingShader->set("light.Linear", LIGHT_LINEAR);
+        lightingShader->set("light.Quadratic", LIGHT_QUADRATIC);
         renderQuad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }}));
 
+    setSsdoResolution(ssdoFactor);
 
-    // SSDO Direct
-    glBindFramebuffer(GL_FRAMEBUFFER, ssdoFBO);
-        glClear(GL_COLOR_BUFFER_BIT);
-        directShader->use();
-        directShader->set ("projectionMat", projectionMatrix);
-        directShader->set ("iViewMat", glm::inverse(viewMatrix));
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gPositionDepth);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, noiseTex);
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxMap);
-        renderQuad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    graph.addPass(compositePass(draw_buffer));
 
-    // SSDO Blur
-    glBindFramebuffer(GL_FRAMEBUFFER, ssdoBlurFBO);
-        glClear(GL_COLOR_BUFFER_BIT);
-        directBlurShader->use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, ssdoTex);
-        renderQuad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    graph.addPass({ "present", {{"composite", 0}}, {FrameGraph::BACKBUFFER}, "", present });
+}
 
+// Restricts the masked passes to the screen rectangle of the bounding sphere of the mesh
+// (of the cube around it, to keep it simple), or to the whole screen if the sphere crosses the near plane
+void updateCoverage () {
+    glm::mat4 modelMatrix = meshPtr->computeTransformMatrix ();
+    glm::vec3 center = glm::vec3 (viewMatrix * modelMatrix * glm::vec4 (meshCenter, 1.f));
+    float scale = std::max (glm::length (glm::vec3 (modelMatrix[0])),
+                            std::max (glm::length (glm::vec3 (modelMatrix[1])), glm::length (glm::vec3 (modelMatrix[2]))));
+    float radius = meshRadius * scale;
+    glm::vec2 lo (1.f), hi (0.f);
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner = center + radius * glm::vec3 (i & 1 ? 1 : -1, i & 2 ? 1 : -1, i & 4 ? 1 : -1);
+        if (corner.z > -cameraPtr->getNear ()) {
+            frameGraphPtr->setCoverage (0.f, 0.f, 1.f, 1.f);
+            return;
+        }
+        glm::vec4 clip = projectionMatrix * glm::vec4 (corner, 1.f);
+        glm::vec2 uv = glm::vec2 (clip) / clip.w * 0.5f + 0.5f;
+        lo = glm::min (lo, uv);
+        hi = glm::max (hi, uv);
+    }
+    frameGraphPtr->setCoverage (lo.x, lo.y, hi.x, hi.y);
+}
 
-    // SSDO Indirect
-    glBindFramebuffer(GL_FRAMEBUFFER, ssdoIndirectFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        indirectShader->use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gPositionDepth);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, noiseTex);
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, ssdoLightingTex);
-        // Send kernel + rotation 
-        indirectShader->set("projectionMat", projectionMatrix);
-        renderQuad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+// The main rendering call
+void render () {
+    Trace::Scope scope ("render");
+    Trace::beginGpu ("frame");
+    const auto start = std::chrono::steady_clock::now ();
+    profilerPtr->beginFrame ();
+    projectionMatrix = cameraPtr->computeProjectionMatrix ();
+    viewMatrix = cameraPtr->computeViewMatrix ();
+    updateCoverage ();
 
-    // SSDO Indirect Blur
-    glBindFramebuffer(GL_FRAMEBUFFER, ssdoIndirectBlurFBO);
-        glClear(GL_COLOR_BUFFER_BIT);
-        indirectBlurShader->use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, ssdoIndirectTex);
-        renderQuad();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    static int graphMode = draw_buffer;
+    if (graphMode != draw_buffer) { // passes not displayed by the new mode get culled
+        graphMode = draw_buffer;
+        frameGraphPtr->addPass(compositePass(graphMode));
+    }
 
-    // Skybox
-    glBindFramebuffer(GL_FRAMEBUFFER, skyboxFBO);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader->use();
-        auto viewM2 = glm::mat4(glm::mat3(viewMatrix)); // no translation
-        skyboxShader->set("viewMat", viewM2);
-        skyboxShader->set("projectionMat", projectionMatrix);
-        // skybox cube
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxMap);
-        renderCube();
-        glDepthFunc(GL_LESS);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // 7. Accumulate Light pass
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    mixerShader->use();
-    mixerShader->set("mode", draw_buffer);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gPositionDepth);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, ssdoTex);
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, ssdoBlurTex);
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, ssdoLightingTex);
-    glActiveTexture(GL_TEXTURE5);
-    glBindTexture(GL_TEXTURE_2D, ssdoIndirectTex);
-    glActiveTexture(GL_TEXTURE6);
-    glBindTexture(GL_TEXTURE_2D, ssdoIndirectBlurTex);
-    glActiveTexture(GL_TEXTURE7);
-    glBindTexture(GL_TEXTURE_2D, skyboxTex);
-    renderQuad();
+    int width, height;
+    framebufferSize (width, height);
+    frameGraphPtr->execute (width, height);
+
+    // This frame's accumulation is the next frame's history
+    if (historyWritten) {
+        for (int i = 0; i < 4; i++)
+            renderTargetsPtr->swap(HISTORY_TARGETS[i], ACCUM_TARGETS[i]);
+        temporalPhase++;
+    }
+    historyValid = historyWritten;
+    historyWritten = false;
+    prevProjectionMatrix = projectionMatrix;
+    prevViewMatrix = viewMatrix;
+    profilerPtr->endFrame (std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ());
+    Trace::endGpu ();
+}
+
+// Headless mode: renders each pose once, and writes the frames to <prefix>0000.png, <prefix>0001.png, etc.
+// Each frame is read back through one of two pixel buffers, so that the GPU renders a pose while the previous frame is
+// being mapped, and the PNG files are encoded on the workers. Returns false if a file could not be written.
+bool renderPoses (const std::vector<Headless::Pose> & poses, const std::string & prefix) {
+    const auto start = std::chrono::steady_clock::now ();
+    const int width = headlessWidth, height = headlessHeight;
+    const size_t bytes = size_t(width) * height * 4;
+    GLuint buffers[2];
+    GLsync fences[2] = { nullptr, nullptr };
+    glCreateBuffers(2, buffers);
+    for (GLuint buffer: buffers)
+        glNamedBufferStorage(buffer, bytes, nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+    std::vector<std::future<bool>> writes;
+    std::vector<std::string> filenames;
+    // Waits for the readback of a frame, and hands it over to the workers
+    auto write = [&] (size_t index) {
+        const int slot = index % 2;
+        glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fences[slot]);
+        auto pixels = std::make_shared<std::vector<unsigned char>> (bytes);
+        std::memcpy(pixels->data(), glMapNamedBufferRange(buffers[slot], 0, bytes, GL_MAP_READ_BIT), bytes);
+        glUnmapNamedBuffer(buffers[slot]);
+        std::ostringstream filename;
+        filename << prefix << std::setw(4) << std::setfill('0') << index << ".png";
+        filenames.push_back(filename.str());
+        const std::string name = filename.str();
+        writes.push_back(threadPoolPtr->submit([name, width, height, pixels] { return Headless::writePng(name, width, height, *pixels); }));
+    };
+    for (size_t i = 0; i < poses.size(); i++) {
+        cameraPtr->setTranslation(poses[i].translation);
+        cameraPtr->setRotation(glm::radians(poses[i].rotation));
+        render();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i % 2]);
+        glGetTextureImage(renderTargetsPtr->texture("composite"), 0, GL_RGBA, GL_UNSIGNED_BYTE, static_cast<GLsizei> (bytes), nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[i % 2] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        Trace::endFrame();
+        if (i > 0)
+            write(i - 1);
+    }
+    if (!poses.empty())
+        write(poses.size() - 1);
+    bool written = true;
+    for (size_t i = 0; i < writes.size(); i++)
+        if (!writes[i].get()) {
+            std::cerr << " > Cannot write " << filenames[i] << std::endl;
+            written = false;
+        }
+    glDeleteBuffers(2, buffers);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - start;
+    std::cout << " > " << poses.size() << " frames of " << width << "x" << height << " written to " << prefix << "*.png in "
+              << elapsed.count() << " s (" << poses.size() / elapsed.count() << " frames/s)" << std::endl;
+    return written;
+}
+
+// Settings of the CPU reference for the camera matrices of the frame, those of the GPU passes it mirrors
+CpuReference::Settings cpuReferenceSettings () {
+    CpuReference::Settings settings;
+    settings.projectionMatrix = projectionMatrix;
+    settings.viewMatrix = viewMatrix;
+    settings.lightPosition = glm::vec3(viewMatrix * LIGHT_POSITION);
+    settings.lightColor = LIGHT_COLOR;
+    settings.lightLinear = LIGHT_LINEAR;
+    settings.lightQuadratic = LIGHT_QUADRATIC;
+    settings.kernel = Sampling::generateKernel(kernelSize, kernelSequence, 0);
+    settings.cosineKernel = Sampling::cosineWeighted(kernelSequence);
+    settings.radius = ssdoRadius;
+    settings.noiseSize = NOISE_SIZE;
+    settings.noise = noiseRotations;
+    settings.sky = environmentPtr.get();
+    settings.blurRadius = blurSettings.radius;
+    settings.spatialSigma = blurSettings.spatialSigma;
+    settings.depthSigma = blurSettings.depthSigma;
+    settings.normalPower = blurSettings.normalPower;
+    return settings;
+}
+
+// Rasterizes the mesh on the CPU for the camera matrices of the frame, and returns the time it took in milliseconds
+double rasterizeOnCpu (int width, int height, CpuReference::GBuffer & gbuffer) {
+    const auto start = std::chrono::steady_clock::now();
+    gbuffer = CpuReference::rasterize(*meshPtr, viewMatrix * meshPtr->computeTransformMatrix(), projectionMatrix, width, height,
+                                      *threadPoolPtr);
+    return std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now() - start).count();
+}
+
+// Renders the current view on the GPU with the passes the CPU reference mirrors (full resolution, separate direct and
+// indirect passes, sky lookup through the spherical harmonics), then on the CPU, from the G-buffer read back from the GPU
+// and from its own rasterization. Prints the throughput of the CPU passes, and the difference of both CPU images with
+// the GPU one over the pixels covered by geometry: the background is looked up in different cube maps.
+void compareCpuReference () {
+    const int factor = ssdoFactor, mode = draw_buffer, sky = skyLookup;
+    const bool fused = fusedSsdo, deinterleaved = deinterleavedSsdo, temporal = temporalSsdo;
+    fusedSsdo = deinterleavedSsdo = temporalSsdo = false;
+    skyLookup = SKY_SH;
+    draw_buffer = 8;
+    setSsdoResolution(1);
+    render();
+    std::vector<unsigned char> gpu;
+    readComposite(gpu);
+    const RenderTargetDesc & desc = renderTargetsPtr->target("composite").desc();
+    const int width = desc.width, height = desc.height;
+    // No transient target is first used after the last readers of the G-buffer: it still holds this frame
+    const CpuReference::GBuffer gbuffer = CpuReference::readGBuffer(renderTargetsPtr->texture("gDepth"),
+                                                                    renderTargetsPtr->texture("gNormal"), width, height);
+    const CpuReference::Settings settings = cpuReferenceSettings();
+    std::vector<CpuReference::Timing> timings;
+    std::vector<unsigned char> images[2];
+    images[0] = CpuReference::render(gbuffer, settings, *threadPoolPtr, &timings);
+    CpuReference::GBuffer rasterized;
+    const double rasterization = rasterizeOnCpu(width, height, rasterized);
+    images[1] = CpuReference::render(rasterized, settings, *threadPoolPtr);
+
+    double errors[2];
+    for (int i = 0; i < 2; i++) {
+        double squares = 0;
+        size_t count = 0;
+        for (size_t p = 0; p < gbuffer.depth.size(); p++) {
+            if (gbuffer.depth[p] == 1.f) continue;
+            for (int c = 0; c < 3; c++) {
+                double d = double(gpu[4 * p + c]) - double(images[i][4 * p + c]);
+                squares += d * d;
+                count++;
+            }
+        }
+        errors[i] = count ? std::sqrt(squares / count) : 0.0;
+    }
+    size_t coverage = 0;
+    for (size_t p = 0; p < gbuffer.depth.size(); p++)
+        coverage += (gbuffer.depth[p] == 1.f) != (rasterized.depth[p] == 1.f);
+
+    std::cout << "> CPU reference at " << width << "x" << height << " on " << threadPoolPtr->size() << " threads:" << std::endl;
+    CpuReference::printTimings(std::cout, timings, width, height);
+    std::cout << "    rasterization: " << rasterization << " ms, " << width * double(height) * 1e-3 / rasterization << " MP/s" << std::endl
+              << "    from the GPU G-buffer: RMSE " << errors[0] << ", PSNR " << psnr(errors[0]) << " dB against the GPU" << std::endl
+              << "    from the CPU G-buffer: RMSE " << errors[1] << ", PSNR " << psnr(errors[1]) << " dB against the GPU, "
+              << coverage << " pixels covered by one rasterization only" << std::endl;
+
+    fusedSsdo = fused;
+    deinterleavedSsdo = deinterleaved;
+    temporalSsdo = temporal;
+    skyLookup = sky;
+    draw_buffer = mode;
+    setSsdoResolution(factor);
+}
+
+// CPU mode: renders each pose with the CPU reference, from its own rasterization, and writes the frames as renderPoses does.
+// Prints the time and throughput of each pass, averaged over the frames. Returns false if a file could not be written.
+bool renderPosesOnCpu (const std::vector<Headless::Pose> & poses, const std::string & prefix) {
+    const auto start = std::chrono::steady_clock::now ();
+    const int width = headlessWidth, height = headlessHeight;
+    std::vector<CpuReference::Timing> timings;
+    bool written = true;
+    for (size_t i = 0; i < poses.size(); i++) {
+        cameraPtr->setTranslation(poses[i].translation);
+        cameraPtr->setRotation(glm::radians(poses[i].rotation));
+        projectionMatrix = cameraPtr->computeProjectionMatrix();
+        viewMatrix = cameraPtr->computeViewMatrix();
+        CpuReference::GBuffer gbuffer;
+        std::vector<CpuReference::Timing> frame = { { "rasterize", rasterizeOnCpu(width, height, gbuffer) } };
+        std::vector<unsigned char> image = CpuReference::render(gbuffer, cpuReferenceSettings(), *threadPoolPtr, &frame);
+        for (size_t t = 0; t < frame.size(); t++) {
+            frame[t].milliseconds /= poses.size();
+            if (i == 0)
+                timings.push_back(frame[t]);
+            else
+                timings[t].milliseconds += frame[t].milliseconds;
+        }
+        std::ostringstream filename;
+        filename << prefix << std::setw(4) << std::setfill('0') << i << ".png";
+        if (!Headless::writePng(filename.str(), width, height, image)) {
+            std::cerr << " > Cannot write " << filename.str() << std::endl;
+            written = false;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - start;
+    std::cout << " > " << poses.size() << " frames of " << width << "x" << height << " rendered on the CPU (" << threadPoolPtr->size()
+              << " threads) to " << prefix << "*.png in " << elapsed.count() << " s, per frame:" << std::endl;
+    CpuReference::printTimings(std::cout, timings, width, height);
+    return written;
 }
 
 // Update any accessible variable based on the current time
@@ -587,24 +1717,116 @@ void update (float currentTime) {
 	
 }
 
+#ifndef BASEGL_BENCH // BenchMain.cpp has its own
+
 void usage (const char * command) {
-	std::cerr << "Usage : " << command << " [<file.off>]" << std::endl;
+	std::cerr << "Usage : " << command << " [<file.off> [<sky directory>...]] [--sky-budget=<MB>] [--trace=<frames>]" << std::endl
+			  << "        [--headless=<width>x<height> | --cpu=<width>x<height>] [--camera=<tx,ty,tz,rx,ry,rz>]... [--cameras=<file>]" << std::endl
+			  << "        [--output=<prefix>]" << std::endl
+			  << "    Each sky directory holds the faces " << SKY_FACES[0];
+	for (size_t i = 1; i < SKY_FACES.size (); i++)
+		std::cerr << ", " << SKY_FACES[i];
+	std::cerr << " of a cube map (default: " << DEFAULT_SKY << ")." << std::endl
+			  << "    --trace records the initialization and the first frames to " << TRACE_FILENAME << "." << std::endl
+			  << "    --headless renders without a window, at the given resolution, one frame per camera pose of the command line" << std::endl
+			  << "    and of the file (one pose per line), to <prefix>0000.png, etc. (default prefix: " << DEFAULT_OUTPUT_PREFIX << ")." << std::endl
+			  << "    A pose is the translation and rotation (in degrees) of the camera around the mesh; default: 0,0,3,0,0,0." << std::endl
+			  << "    --cpu does the same without any GPU, with the CPU reference of the pipeline, and prints its throughput." << std::endl;
 	std::exit (EXIT_FAILURE);
 }
 
 int main (int argc, char ** argv) {
-	if (argc > 2)
-		usage (argv[0]);
-	init (argc == 1 ? DEFAULT_MESH_FILENAME : argv[1]); // Your initialization code (user interface, OpenGL states, scene with geometry, material, lights, etc)
+	std::string meshFilename = DEFAULT_MESH_FILENAME;
+	std::vector<std::string> positional;
+	std::vector<Headless::Pose> poses;
+	std::string outputPrefix = DEFAULT_OUTPUT_PREFIX;
+	bool posesGiven = false;
+	for (int i = 1; i < argc; i++) {
+		const std::string argument = argv[i];
+		const std::string budgetOption = "--sky-budget=", traceOption = "--trace=", headlessOption = "--headless=",
+			cameraOption = "--camera=", camerasOption = "--cameras=", outputOption = "--output=", cpuOption = "--cpu=";
+		if (argument.compare (0, budgetOption.size (), budgetOption) == 0) {
+			int megabytes = std::atoi (argument.c_str () + budgetOption.size ());
+			if (megabytes <= 0)
+				usage (argv[0]);
+			skyBudget = size_t (megabytes) << 20;
+		} else if (argument.compare (0, traceOption.size (), traceOption) == 0) {
+			int frames = std::atoi (argument.c_str () + traceOption.size ());
+			if (frames <= 0)
+				usage (argv[0]);
+			Trace::start (TRACE_FILENAME, frames);
+		} else if (argument.compare (0, headlessOption.size (), headlessOption) == 0
+				   || argument.compare (0, cpuOption.size (), cpuOption) == 0) {
+			cpuRendering = argument.compare (0, cpuOption.size (), cpuOption) == 0;
+			if (std::sscanf (argument.c_str () + argument.find ('=') + 1, "%dx%d", &headlessWidth, &headlessHeight) != 2
+				|| headlessWidth <= 0 || headlessHeight <= 0)
+				usage (argv[0]);
+		} else if (argument.compare (0, cameraOption.size (), cameraOption) == 0
+				   || argument.compare (0, camerasOption.size (), camerasOption) == 0) {
+			try {
+				if (argument.compare (0, cameraOption.size (), cameraOption) == 0)
+					poses.push_back (Headless::parsePose (argument.substr (cameraOption.size ())));
+				else {
+					std::vector<Headless::Pose> file = Headless::readPoses (argument.substr (camerasOption.size ()));
+					poses.insert (poses.end (), file.begin (), file.end ());
+				}
+			} catch (std::exception & e) {
+				std::cerr << "ERROR: " << e.what () << std::endl;
+				usage (argv[0]);
+			}
+			posesGiven = true;
+		} else if (argument.compare (0, outputOption.size (), outputOption) == 0)
+			outputPrefix = argument.substr (outputOption.size ());
+		else if (argument.compare (0, 2, "--") == 0)
+			usage (argv[0]);
+		else
+			positional.push_back (argument);
+	}
+	if (!positional.empty ())
+		meshFilename = positional[0];
+	if (positional.size () > 1)
+		skyDirectories.assign (positional.begin () + 1, positional.end ());
+	if (headlessWidth == 0 && (posesGiven || outputPrefix != DEFAULT_OUTPUT_PREFIX))
+		usage (argv[0]); // the poses are for the headless mode
+	init (meshFilename); // Your initialization code (user interface, OpenGL states, scene with geometry, material, lights, etc)
+
+	if (headlessWidth > 0) {
+		if (!posesGiven) { // the initial camera
+			Headless::Pose pose;
+			pose.translation = cameraPtr->getTranslation ();
+			poses.push_back (pose);
+		}
+		bool written = cpuRendering ? renderPosesOnCpu (poses, outputPrefix) : renderPoses (poses, outputPrefix);
+		Trace::stop (); // fewer poses than traced frames
+		clear ();
+		return written ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
 
 	while (!glfwWindowShouldClose (windowPtr)) {
 		update (static_cast<float> (glfwGetTime ()));
-		render ();
-		glfwSwapBuffers (windowPtr);
-		glfwPollEvents ();
+		{
+			Trace::Scope scope ("updateSky");
+			updateSky ();
+		}
+		applyPendingResize ();
+		if (needsRedraw () || Trace::enabled ()) { // a trace records consecutive frames
+			render ();
+			{
+				Trace::Scope scope ("swap");
+				glfwSwapBuffers (windowPtr);
+			}
+			Trace::endFrame ();
+			glfwPollEvents ();
+		} else if (resizePending)
+			glfwWaitEventsTimeout (RESIZE_DELAY); // Wake up to apply the resize
+		else if (environmentsPtr->loading ())
+			glfwWaitEventsTimeout (SKY_POLL_DELAY); // Wake up to upload the skies loaded in the background
+		else
+			glfwWaitEvents (); // Idle: the last frame stays on screen until an event changes something
 	}
 	clear ();
 	std::cout << " > Quit" << std::endl;
 	return EXIT_SUCCESS;
 }
 
+#endif // BASEGL_BENCH
@@ -5,6 +5,8 @@
 #include <cmath>
 #include <algorithm>
 
+#include "Trace.h"
+
 using namespace std;
 
 Mesh::~Mesh () {
@@ -22,6 +24,7 @@ void Mesh::computeBoundingSphere (glm::vec3 & center, float & radius) const {
 }
 
 void Mesh::standardize () {
+    touch ();
     glm::vec3 center;
     float radius;
     this->computeBoundingSphere(center, radius);
@@ -30,6 +33,8 @@ void Mesh::standardize () {
 }
 
 void Mesh::recomputePerVertexNormals (bool angleBased) {
+	Trace::Scope scope ("compute normals");
+	touch ();
 	m_vertexNormals.clear ();
 	// Change the following code to compute a proper per-vertex normal
 	m_vertexNormals.resize (m_vertexPositions.size (), glm::vec3 (0.0, 0.0, 0.0));
@@ -51,6 +56,7 @@ void Mesh::recomputePerVertexNormals (bool angleBased) {
 }
 
 void Mesh::init () {
+	touch ();
 	glCreateBuffers (1, &m_posVbo); // Generate a GPU buffer to store the positions of the vertices
 	size_t vertexBufferSize = sizeof (glm::vec3) * m_vertexPositions.size (); // Gather the size of the buffer from the CPU-side vector
 	glNamedBufferStorage (m_posVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT); // Create a data store on the GPU
@@ -85,12 +91,18 @@ void Mesh::init () {
 	glBindVertexArray (0); // Desactive the VAO just created. Will be activated at rendering time. 
 }
 
+size_t Mesh::gpuBytes () const {
+	return sizeof (glm::vec3) * (m_vertexPositions.size () + m_vertexNormals.size ())
+		+ sizeof (glm::vec2) * m_vertexTexCoords.size () + sizeof (glm::uvec3) * m_triangleIndices.size ();
+}
+
 void Mesh::render () {
 	glBindVertexArray (m_vao); // Activate the VAO storing geometry data
 	glDrawElements (GL_TRIANGLES, static_cast<GLsizei> (m_triangleIndices.size () * 3), GL_UNSIGNED_INT, 0); // Call for rendering: stream the current GPU geometry through the current GPU program
 }
 
 void Mesh::clear () {
+	touch ();
 	m_vertexPositions.clear ();
 	m_vertexNormals.clear ();
 	m_vertexTexCoords.clear ();
@@ -14,14 +14,15 @@ class Mesh : public Transform {
 public:
 	virtual ~Mesh ();
 
+	/// Changes made through the non-const accessors and methods (render () aside) bump the revision of the mesh
 	inline const std::vector<glm::vec3> & vertexPositions () const { return m_vertexPositions; } 
-	inline std::vector<glm::vec3> & vertexPositions () { return m_vertexPositions; }
+	inline std::vector<glm::vec3> & vertexPositions () { touch (); return m_vertexPositions; }
 	inline const std::vector<glm::vec3> & vertexNormals () const { return m_vertexNormals; } 
-	inline std::vector<glm::vec3> & vertexNormals () { return m_vertexNormals; } 
+	inline std::vector<glm::vec3> & vertexNormals () { touch (); return m_vertexNormals; } 
 	inline const std::vector<glm::vec2> & vertexTexCoords () const { return m_vertexTexCoords; } 
-	inline std::vector<glm::vec2> & vertexTexCoords () { return m_vertexTexCoords; }  
+	inline std::vector<glm::vec2> & vertexTexCoords () { touch (); return m_vertexTexCoords; }  
 	inline const std::vector<glm::uvec3> & triangleIndices () const { return m_triangleIndices; }
-	inline std::vector<glm::uvec3> & triangleIndices () { return m_triangleIndices; }
+	inline std::vector<glm::uvec3> & triangleIndices () { touch (); return m_triangleIndices; }
 
 	/// Compute the parameters of a sphere which bounds the mesh
 	void computeBoundingSphere (glm::vec3 & center, float & radius) const;
@@ -33,6 +34,9 @@ public:
 	void render ();
 	void clear ();
 
+	/// GPU memory of the buffers created by init
+	size_t gpuBytes () const;
+
 private:
 	std::vector<glm::vec3> m_vertexPositions;
 	std::vector<glm::vec3> m_vertexNormals;
@@ -5,9 +5,12 @@
 #include <exception>
 #include <ios>
 
+#include "Trace.h"
+
 using namespace std;
 
 void MeshLoader::loadOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr) {
+	Trace::Scope scope ("load mesh");
 	std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
     meshPtr->clear ();
 	ifstream in (filename.c_str ());
@@ -0,0 +1,152 @@
+#include "Profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+const std::string Profiler::GPU_FRAME ("frame (GPU)");
+const std::string Profiler::CPU_FRAME ("frame (CPU)");
+
+Profiler::Profiler (size_t window) : m_window (std::max (size_t (1), window)) {}
+
+Profiler::~Profiler () {
+	for (auto & frame : m_frames)
+		if (!frame.queries.empty ())
+			glDeleteQueries (static_cast<GLsizei> (frame.queries.size ()), frame.queries.data ());
+}
+
+void Profiler::poll () {
+	// Timestamps complete in order: the frame is done once its last one is available
+	for (auto & frame : m_frames) {
+		if (!frame.pending)
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv (frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+			collect (frame);
+	}
+}
+
+void Profiler::wait () {
+	for (auto & frame : m_frames)
+		if (frame.pending)
+			collect (frame); // reading the results waits for them
+}
+
+void Profiler::beginFrame () {
+	poll ();
+	m_current = (m_current + 1) % FRAMES_IN_FLIGHT;
+	Frame & frame = m_frames[m_current];
+	if (frame.pending && m_blocking)
+		collect (frame);
+	else if (frame.pending) { // the GPU is that far behind: rather than wait for it, reuse the queries
+		frame.pending = false;
+		m_dropped++;
+	}
+	frame.used = 0;
+	frame.passes.clear ();
+	glQueryCounter (timestamp (frame), GL_TIMESTAMP);
+}
+
+void Profiler::endPass (const std::string & name) {
+	Frame & frame = m_frames[m_current];
+	glQueryCounter (timestamp (frame), GL_TIMESTAMP);
+	frame.passes.push_back (name);
+}
+
+void Profiler::endFrame (double cpuMilliseconds) {
+	Frame & frame = m_frames[m_current];
+	frame.pending = !frame.passes.empty ();
+	add (CPU_FRAME, cpuMilliseconds);
+}
+
+GLuint Profiler::timestamp (Frame & frame) {
+	if (frame.used == frame.queries.size ()) {
+		GLuint query;
+		glCreateQueries (GL_TIMESTAMP, 1, &query);
+		frame.queries.push_back (query);
+	}
+	return frame.queries[frame.used++];
+}
+
+void Profiler::collect (Frame & frame) {
+	std::vector<GLuint64> times (frame.used);
+	for (size_t i = 0; i < frame.used; i++)
+		glGetQueryObjectui64v (frame.queries[i], GL_QUERY_RESULT, &times[i]);
+	for (size_t i = 0; i < frame.passes.size (); i++)
+		add (frame.passes[i], (times[i + 1] - times[i]) * 1e-6);
+	add (GPU_FRAME, (times[frame.used - 1] - times[0]) * 1e-6);
+	frame.pending = false;
+}
+
+void Profiler::add (const std::string & name, double milliseconds) {
+	auto it = std::find_if (m_series.begin (), m_series.end (), [&] (const Series & s) { return s.name == name; });
+	if (it == m_series.end ()) {
+		m_series.push_back (Series ());
+		it = m_series.end () - 1;
+		it->name = name;
+	}
+	if (it->samples.size () < m_window)
+		it->samples.push_back (milliseconds);
+	else
+		it->samples[it->next] = milliseconds;
+	it->next = (it->next + 1) % m_window;
+}
+
+std::vector<Profiler::Stats> Profiler::stats () const {
+	std::vector<Stats> result;
+	for (const auto & series : m_series) {
+		std::vector<double> sorted = series.samples;
+		std::sort (sorted.begin (), sorted.end ());
+		double sum = 0.0;
+		for (double sample : sorted)
+			sum += sample;
+		// Nearest rank percentile
+		auto percentile = [&] (double p) {
+			size_t rank = static_cast<size_t> (std::ceil (p * sorted.size ()));
+			return sorted[std::max (size_t (1), rank) - 1];
+		};
+		result.push_back ({ series.name, sorted.size (), sum / sorted.size (), percentile (0.5), percentile (0.95), percentile (0.99) });
+	}
+	// The whole frame last
+	for (const std::string & name : { GPU_FRAME, CPU_FRAME }) {
+		auto it = std::find_if (result.begin (), result.end (), [&] (const Stats & s) { return s.name == name; });
+		if (it != result.end ())
+			std::rotate (it, it + 1, result.end ());
+	}
+	return result;
+}
+
+void Profiler::print (std::ostream & out) const {
+	std::vector<Stats> all = stats ();
+	size_t width = 4;
+	for (const auto & s : all)
+		width = std::max (width, s.name.size ());
+	out << "> Frame timings in ms, over the last " << m_window << " frames at most (" << m_dropped << " dropped while in flight)" << std::endl;
+	out << "    " << std::left << std::setw (width) << "pass" << std::right
+		<< std::setw (10) << "mean" << std::setw (10) << "p50" << std::setw (10) << "p95" << std::setw (10) << "p99"
+		<< std::setw (10) << "frames" << std::endl;
+	std::ios::fmtflags flags = out.flags ();
+	std::streamsize precision = out.precision ();
+	out << std::fixed << std::setprecision (3);
+	for (const auto & s : all)
+		out << "    " << std::left << std::setw (width) << s.name << std::right
+			<< std::setw (10) << s.mean << std::setw (10) << s.p50 << std::setw (10) << s.p95 << std::setw (10) << s.p99
+			<< std::setw (10) << s.samples << std::endl;
+	out.flags (flags);
+	out.precision (precision);
+}
+
+bool Profiler::writeCsv (const std::string & filename) const {
+	ofstream out (filename.c_str ());
+	if (!out)
+		return false;
+	out << "pass,frames,mean_ms,p50_ms,p95_ms,p99_ms" << std::endl;
+	out << std::setprecision (6);
+	for (const auto & s : stats ())
+		out << s.name << "," << s.samples << "," << s.mean << "," << s.p50 << "," << s.p95 << "," << s.p99 << std::endl;
+	return static_cast<bool> (out);
+}
@@ -0,0 +1,89 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <ostream>
+
+/// GPU time of each pass of the frames, from timestamp queries written between the passes, and CPU time of the frames.
+/// The queries of a frame are read back once the GPU is done with them, a few frames later, so that the CPU never waits:
+/// a frame whose queries are still pending when its set of queries comes round again is dropped. The statistics are over
+/// the last frames measured, unless the profiler blocks. Every method requires a valid OpenGL context.
+class Profiler {
+public:
+	/// Sets of queries in flight, and number of frames in the statistics
+	static const int FRAMES_IN_FLIGHT = 2;
+	static const size_t DEFAULT_WINDOW = 256;
+
+	/// Name of the GPU time of the whole frame, and of the CPU time
+	static const std::string GPU_FRAME;
+	static const std::string CPU_FRAME;
+
+	explicit Profiler (size_t window = DEFAULT_WINDOW);
+	virtual ~Profiler ();
+
+	Profiler (const Profiler &) = delete;
+	Profiler & operator= (const Profiler &) = delete;
+
+	/// Reads back the frames done on the GPU
+	void poll ();
+
+	/// Whether beginFrame waits for the GPU to be done with the queries it reuses, rather than drop their frame: for
+	/// benchmarks, which need every frame, at the cost of keeping at most FRAMES_IN_FLIGHT frames in flight
+	inline void setBlocking (bool blocking) { m_blocking = blocking; }
+
+	/// Waits for the frames in flight, and reads them back
+	void wait ();
+
+	/// Polls, and starts timing a new frame
+	void beginFrame ();
+
+	/// End of a pass of the frame, which started at the end of the previous one (or at beginFrame)
+	void endPass (const std::string & name);
+
+	/// End of the frame, which took the given CPU time
+	void endFrame (double cpuMilliseconds);
+
+	/// Rolling statistics of a pass, in milliseconds
+	struct Stats {
+		std::string name;
+		size_t samples;
+		double mean, p50, p95, p99;
+	};
+
+	/// Statistics of the passes, in the order of their first measure, then of the whole frame on the GPU and on the CPU
+	std::vector<Stats> stats () const;
+
+	void print (std::ostream & out) const;
+
+	/// Writes the statistics as comma-separated values, one line per pass after a header. Returns false on failure.
+	bool writeCsv (const std::string & filename) const;
+
+private:
+	struct Series {
+		std::string name;
+		std::vector<double> samples; // ring buffer of the last m_window
+		size_t next = 0;
+	};
+
+	struct Frame {
+		std::vector<GLuint> queries; // timestamps: begin, then the end of each pass
+		std::vector<std::string> passes;
+		size_t used = 0;
+		bool pending = false;
+	};
+
+	void add (const std::string & name, double milliseconds);
+	GLuint timestamp (Frame & frame);
+	void collect (Frame & frame);
+
+	size_t m_window;
+	std::vector<Series> m_series;
+	Frame m_frames[FRAMES_IN_FLIGHT];
+	int m_current = 0;
+	size_t m_dropped = 0;
+	bool m_blocking = false;
+};
+
+#endif // PROFILER_H
@@ -85,3 +85,13 @@ void renderCube() {
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glBindVertexArray(0);
 }
+
+void clearPrimitives() {
+    GLuint *VAOs[] = { &quadVAO, &cubeVAO };
+    GLuint *VBOs[] = { &quadVBO, &cubeVBO };
+    for (int i=0; i<2; i++) {
+        if (*VAOs[i]) glDeleteVertexArrays(1, VAOs[i]);
+        if (*VBOs[i]) glDeleteBuffers(1, VBOs[i]);
+        *VAOs[i] = *VBOs[i] = 0;
+    }
+}
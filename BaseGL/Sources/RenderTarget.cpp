@@ -0,0 +1,328 @@
+#include "RenderTarget.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <set>
+#include <cmath>
+
+using namespace std;
+
+static size_t bytesPerPixel (GLenum format) {
+	switch (format) {
+	case GL_R8: return 1;
+	case GL_RG8: case GL_R16F: case GL_R16: return 2;
+	case GL_RGB8: return 3;
+	case GL_RGBA8: case GL_RG16F: case GL_RG16: case GL_RG16_SNORM: case GL_R32F: case GL_R11F_G11F_B10F:
+	case GL_DEPTH_COMPONENT24: case GL_DEPTH24_STENCIL8: case GL_DEPTH_COMPONENT32F: return 4;
+	case GL_RGB16F: return 6;
+	case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+	case GL_RGB32F: return 12;
+	case GL_RGBA32F: return 16;
+	default: return 4;
+	}
+}
+
+size_t RenderTargetDesc::byteSize () const {
+	size_t bytes = 0;
+	for (GLsizei level = 0; level < levels; level++)
+		bytes += static_cast<size_t> (std::max (1, width >> level)) * std::max (1, height >> level);
+	return bytes * layers * bytesPerPixel (format);
+}
+
+RenderTarget::RenderTarget (const RenderTargetDesc & desc) : m_desc (desc) {
+	// Immutable storage: size and format can not change afterwards
+	if (desc.layers > 1) {
+		glCreateTextures (GL_TEXTURE_2D_ARRAY, 1, &m_id);
+		glTextureStorage3D (m_id, desc.levels, desc.format, desc.width, desc.height, desc.layers);
+	} else {
+		glCreateTextures (GL_TEXTURE_2D, 1, &m_id);
+		glTextureStorage2D (m_id, desc.levels, desc.format, desc.width, desc.height);
+	}
+	glTextureParameteri (m_id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri (m_id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri (m_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri (m_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+RenderTarget::~RenderTarget () {
+	glDeleteTextures (1, &m_id);
+}
+
+Framebuffer::Framebuffer () {
+	glCreateFramebuffers (1, &m_id);
+}
+
+Framebuffer::~Framebuffer () {
+	glDeleteFramebuffers (1, &m_id);
+}
+
+void Framebuffer::attach (GLenum attachment, const RenderTarget & target) {
+	glNamedFramebufferTexture (m_id, attachment, target.id (), 0);
+}
+
+void Framebuffer::setDrawBuffers (int count) {
+	vector<GLenum> attachments;
+	for (int i = 0; i < count; i++)
+		attachments.push_back (GL_COLOR_ATTACHMENT0 + i);
+	glNamedFramebufferDrawBuffers (m_id, count, attachments.data ());
+}
+
+bool Framebuffer::isComplete () const {
+	return glCheckNamedFramebufferStatus (m_id, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+std::shared_ptr<RenderTarget> RenderTargetPool::acquire (const RenderTargetDesc & desc) {
+	auto it = m_free.find (desc);
+	if (it != m_free.end ()) {
+		auto target = it->second;
+		m_free.erase (it);
+		m_pooledBytes -= desc.byteSize ();
+		return target;
+	}
+	m_allocationCount++;
+	return std::make_shared<RenderTarget> (desc);
+}
+
+void RenderTargetPool::release (std::shared_ptr<RenderTarget> target) {
+	if (!target)
+		return;
+	m_pooledBytes += target->desc ().byteSize ();
+	m_free.emplace (target->desc (), target);
+}
+
+void RenderTargetPool::trim (const std::vector<RenderTargetDesc> & keep) {
+	for (auto it = m_free.begin (); it != m_free.end ();) {
+		if (std::find (keep.begin (), keep.end (), it->first) == keep.end ()) {
+			m_pooledBytes -= it->first.byteSize ();
+			it = m_free.erase (it);
+		} else
+			++it;
+	}
+}
+
+void RenderTargetPool::clear () {
+	m_free.clear ();
+	m_pooledBytes = 0;
+}
+
+RenderTargetManager::~RenderTargetManager () {
+	clear ();
+}
+
+void RenderTargetManager::declare (const std::string & name, GLenum format, float scale, bool transient,
+									   GLsizei layers, bool mipmapped) {
+	m_framebuffers.clear ();
+	bool transients = releaseSlot (name); // a redeclared target gets its storage back from the pool
+	Slot slot = { format, scale, transient, layers, mipmapped, nullptr };
+	if (m_width > 0 && m_height > 0 && !transient)
+		slot.target = m_pool.acquire (descOf (slot));
+	m_slots[name] = slot;
+	if (transients)
+		allocateTransients ();
+}
+
+void RenderTargetManager::remove (const std::string & name) {
+	m_framebuffers.clear ();
+	bool transients = releaseSlot (name);
+	m_slots.erase (name);
+	m_lifetimes.erase (name);
+	if (transients)
+		allocateTransients ();
+}
+
+// Returns the storage of a declared target to the pool. The storage of a transient target may be aliased by others:
+// all the transient storage is released then, for allocateTransients to hand it out again. Returns whether it was.
+bool RenderTargetManager::releaseSlot (const std::string & name) {
+	auto it = m_slots.find (name);
+	if (it == m_slots.end () || !it->second.target)
+		return false;
+	if (it->second.transient) {
+		releaseTransients ();
+		return true;
+	}
+	m_pool.release (it->second.target);
+	it->second.target.reset ();
+	return false;
+}
+
+void RenderTargetManager::setLifetimes (const std::map<std::string, Lifetime> & lifetimes) {
+	m_lifetimes = lifetimes;
+	allocateTransients ();
+	report ();
+}
+
+void RenderTargetManager::releaseTransients () {
+	m_framebuffers.clear ();
+	std::set<RenderTarget *> released; // aliased storage goes back to the pool only once
+	for (auto & it : m_slots) {
+		Slot & slot = it.second;
+		if (!slot.transient)
+			continue;
+		if (slot.target && released.insert (slot.target.get ()).second)
+			m_pool.release (slot.target);
+		slot.target.reset ();
+	}
+}
+
+void RenderTargetManager::allocateTransients () {
+	releaseTransients ();
+	if (m_width == 0 || m_height == 0)
+		return;
+
+	// Linear scan over the targets sorted by first use. Storage whose last user ran before
+	// the current target's first user is dead, and can be handed over.
+	std::vector<std::pair<int, std::string>> order;
+	for (const auto & it : m_lifetimes) {
+		auto slot = m_slots.find (it.first);
+		if (slot != m_slots.end () && slot->second.transient)
+			order.push_back ({it.second.first, it.first});
+	}
+	std::sort (order.begin (), order.end ());
+	std::vector<std::pair<int, std::shared_ptr<RenderTarget>>> live; // last use, storage
+	std::multimap<RenderTargetDesc, std::shared_ptr<RenderTarget>> dead;
+	for (const auto & it : order) {
+		for (auto l = live.begin (); l != live.end ();) {
+			if (l->first < it.first) {
+				dead.emplace (l->second->desc (), l->second);
+				l = live.erase (l);
+			} else
+				++l;
+		}
+		Slot & slot = m_slots[it.second];
+		RenderTargetDesc desc = descOf (slot);
+		auto d = dead.find (desc);
+		if (d != dead.end ()) {
+			slot.target = d->second;
+			dead.erase (d);
+		} else
+			slot.target = m_pool.acquire (desc);
+		live.push_back ({m_lifetimes[it.second].last, slot.target});
+	}
+}
+
+void RenderTargetManager::report () const {
+	std::cout << " > Render targets " << m_width << "x" << m_height << ": "
+			  << allocatedBytes () / (1 << 20) << " MB (" << unaliasedBytes () / (1 << 20) << " MB without aliasing), "
+			  << m_pool.pooledBytes () / (1 << 20) << " MB pooled" << std::endl;
+}
+
+RenderTargetDesc RenderTargetManager::descOf (const Slot & slot) const {
+	RenderTargetDesc desc;
+	// Rounded up, so that every pixel of the screen has a (possibly shared) texel in downscaled targets
+	desc.width = std::max (1, static_cast<GLsizei> (std::ceil (m_width * slot.scale)));
+	desc.height = std::max (1, static_cast<GLsizei> (std::ceil (m_height * slot.scale)));
+	desc.format = slot.format;
+	desc.layers = slot.layers;
+	if (slot.mipmapped)
+		while (std::max (desc.width, desc.height) >> desc.levels)
+			desc.levels++;
+	return desc;
+}
+
+void RenderTargetManager::resize (GLsizei width, GLsizei height) {
+	if (width == m_width && height == m_height)
+		return;
+	m_framebuffers.clear ();
+	// The targets of the size we leave stay pooled, so that going back to it (e.g., un-maximizing) does not reallocate
+	std::vector<RenderTargetDesc> previous;
+	for (auto & it : m_slots)
+		if (it.second.target)
+			previous.push_back (it.second.target->desc ());
+	releaseTransients ();
+	for (auto & it : m_slots) {
+		if (it.second.transient)
+			continue;
+		m_pool.release (it.second.target);
+		it.second.target.reset ();
+	}
+	m_width = width;
+	m_height = height;
+	for (auto & it : m_slots)
+		if (!it.second.transient)
+			it.second.target = m_pool.acquire (descOf (it.second));
+	allocateTransients ();
+	m_pool.trim (previous);
+	if (!m_lifetimes.empty ())
+		report ();
+}
+
+void RenderTargetManager::swap (const std::string & a, const std::string & b) {
+	auto first = m_slots.find (a), second = m_slots.find (b);
+	if (first == m_slots.end () || second == m_slots.end ())
+		throw std::runtime_error ("[Render Target Manager][swap] Unknown target " + (first == m_slots.end () ? a : b));
+	if (first->second.transient || second->second.transient || !(descOf (first->second) == descOf (second->second)))
+		throw std::runtime_error ("[Render Target Manager][swap] " + a + " and " + b + " are not interchangeable");
+	std::swap (first->second.target, second->second.target);
+	dropFramebuffers (a);
+	dropFramebuffers (b);
+}
+
+void RenderTargetManager::dropFramebuffers (const std::string & name) {
+	// Keys are the depth target followed by "|color" for each color target
+	for (auto it = m_framebuffers.begin (); it != m_framebuffers.end ();) {
+		const std::string key = "|" + it->first + "|";
+		if (key.find ("|" + name + "|") != std::string::npos)
+			it = m_framebuffers.erase (it);
+		else
+			++it;
+	}
+}
+
+const RenderTarget & RenderTargetManager::target (const std::string & name) const {
+	auto it = m_slots.find (name);
+	if (it == m_slots.end () || !it->second.target)
+		throw std::runtime_error ("[Render Target Manager][target] Unknown target " + name);
+	return *it->second.target;
+}
+
+GLuint RenderTargetManager::framebuffer (const std::vector<std::string> & colors, const std::string & depth) {
+	std::string key = depth;
+	for (const auto & name : colors)
+		key += "|" + name;
+	auto & fbo = m_framebuffers[key];
+	if (!fbo) {
+		fbo.reset (new Framebuffer ());
+		for (size_t i = 0; i < colors.size (); i++)
+			fbo->attach (GL_COLOR_ATTACHMENT0 + i, target (colors[i]));
+		if (!depth.empty ()) {
+			GLenum format = target (depth).desc ().format;
+			bool stencil = format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+			fbo->attach (stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, target (depth));
+		}
+		fbo->setDrawBuffers (static_cast<int> (colors.size ()));
+		if (!fbo->isComplete ())
+			std::cout << "Framebuffer " << key << " not complete!" << std::endl;
+	}
+	return fbo->id ();
+}
+
+void RenderTargetManager::bind (const std::vector<std::string> & colors, const std::string & depth) {
+	glBindFramebuffer (GL_FRAMEBUFFER, framebuffer (colors, depth));
+	const RenderTargetDesc & desc = target (colors.empty () ? depth : colors[0]).desc ();
+	glViewport (0, 0, desc.width, desc.height);
+}
+
+size_t RenderTargetManager::allocatedBytes () const {
+	std::set<const RenderTarget *> counted;
+	size_t bytes = 0;
+	for (const auto & it : m_slots)
+		if (it.second.target && counted.insert (it.second.target.get ()).second)
+			bytes += it.second.target->desc ().byteSize ();
+	return bytes;
+}
+
+size_t RenderTargetManager::unaliasedBytes () const {
+	size_t bytes = 0;
+	for (const auto & it : m_slots)
+		bytes += descOf (it.second).byteSize ();
+	return bytes;
+}
+
+void RenderTargetManager::clear () {
+	m_framebuffers.clear ();
+	m_slots.clear ();
+	m_lifetimes.clear ();
+	m_pool.clear ();
+	m_width = m_height = 0;
+}
@@ -0,0 +1,169 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+/// Size and internal format of a 2D render target, or of a 2D array render target if it has several layers
+struct RenderTargetDesc {
+	GLsizei width = 0;
+	GLsizei height = 0;
+	GLenum format = GL_RGBA8;
+	GLsizei layers = 1;
+	GLsizei levels = 1; // Mipmap levels
+
+	/// GPU memory used by one texture of this kind
+	size_t byteSize () const;
+
+	inline bool operator< (const RenderTargetDesc & o) const {
+		if (width != o.width) return width < o.width;
+		if (height != o.height) return height < o.height;
+		if (format != o.format) return format < o.format;
+		if (layers != o.layers) return layers < o.layers;
+		return levels < o.levels;
+	}
+	inline bool operator== (const RenderTargetDesc & o) const {
+		return width == o.width && height == o.height && format == o.format && layers == o.layers && levels == o.levels;
+	}
+};
+
+/// Immutable 2D (or 2D array) texture usable as a framebuffer attachment or an image. Owns its OpenGL name.
+class RenderTarget {
+public:
+	explicit RenderTarget (const RenderTargetDesc & desc);
+	virtual ~RenderTarget ();
+
+	RenderTarget (const RenderTarget &) = delete;
+	RenderTarget & operator= (const RenderTarget &) = delete;
+
+	inline GLuint id () const { return m_id; }
+	inline const RenderTargetDesc & desc () const { return m_desc; }
+
+private:
+	RenderTargetDesc m_desc;
+	GLuint m_id = 0;
+};
+
+/// Framebuffer object. Owns its OpenGL name, but not its attachments.
+class Framebuffer {
+public:
+	Framebuffer ();
+	virtual ~Framebuffer ();
+
+	Framebuffer (const Framebuffer &) = delete;
+	Framebuffer & operator= (const Framebuffer &) = delete;
+
+	inline GLuint id () const { return m_id; }
+
+	void attach (GLenum attachment, const RenderTarget & target);
+
+	/// Enables the given number of color attachments, starting from GL_COLOR_ATTACHMENT0
+	void setDrawBuffers (int count);
+
+	bool isComplete () const;
+
+private:
+	GLuint m_id = 0;
+};
+
+/// Keeps released render targets so that they can be handed back out when the same size and format is requested again.
+class RenderTargetPool {
+public:
+	std::shared_ptr<RenderTarget> acquire (const RenderTargetDesc & desc);
+	void release (std::shared_ptr<RenderTarget> target);
+
+	/// Frees the pooled targets whose size and format is not listed
+	void trim (const std::vector<RenderTargetDesc> & keep);
+	void clear ();
+
+	inline size_t pooledBytes () const { return m_pooledBytes; }
+	inline size_t allocationCount () const { return m_allocationCount; }
+
+private:
+	std::multimap<RenderTargetDesc, std::shared_ptr<RenderTarget>> m_free;
+	size_t m_pooledBytes = 0;
+	size_t m_allocationCount = 0;
+};
+
+/// Named screen-sized render targets, and the framebuffers built on them.
+/// Targets are reallocated through a pool whenever the screen size changes.
+/// Transient targets only live within a frame: they get storage once their lifetimes are known,
+/// and targets of the same size and format whose lifetimes do not overlap share the same texture.
+class RenderTargetManager {
+public:
+	/// First and last pass using a target, in execution order
+	struct Lifetime {
+		int first;
+		int last;
+	};
+
+	virtual ~RenderTargetManager ();
+
+	/// Registers a target. Its size is the screen size times scale, rounded up. A mipmapped target gets a full mip chain.
+	void declare (const std::string & name, GLenum format, float scale = 1.f, bool transient = false,
+				  GLsizei layers = 1, bool mipmapped = false);
+
+	/// Unregisters a target, if declared
+	void remove (const std::string & name);
+
+	/// Allocates the transient targets for the given lifetimes, aliasing the ones that never live at the same time.
+	/// Transient targets without a lifetime (i.e., unused) get no storage.
+	void setLifetimes (const std::map<std::string, Lifetime> & lifetimes);
+
+	/// Exchanges the storage of two persistent targets of the same size and format, e.g., to ping-pong
+	/// between the history read by a pass and the one it writes
+	void swap (const std::string & a, const std::string & b);
+
+	/// Reallocates every declared target for the new screen size. Framebuffers are rebuilt lazily.
+	void resize (GLsizei width, GLsizei height);
+
+	inline GLsizei width () const { return m_width; }
+	inline GLsizei height () const { return m_height; }
+
+	const RenderTarget & target (const std::string & name) const;
+	inline GLuint texture (const std::string & name) const { return target (name).id (); }
+
+	/// Framebuffer rendering into the given color targets, plus an optional depth (or depth-stencil) target
+	GLuint framebuffer (const std::vector<std::string> & colors, const std::string & depth = "");
+
+	/// Binds the framebuffer of the given targets and sets the viewport to their size
+	void bind (const std::vector<std::string> & colors, const std::string & depth = "");
+
+	/// GPU memory held by the live targets, counting aliased storage once
+	size_t allocatedBytes () const;
+
+	/// GPU memory the declared targets would use with a texture each
+	size_t unaliasedBytes () const;
+
+	/// Frees every target and framebuffer. A valid OpenGL context must be active.
+	void clear ();
+
+private:
+	struct Slot {
+		GLenum format;
+		float scale;
+		bool transient;
+		GLsizei layers;
+		bool mipmapped;
+		std::shared_ptr<RenderTarget> target;
+	};
+
+	RenderTargetDesc descOf (const Slot & slot) const;
+	bool releaseSlot (const std::string & name);
+	void releaseTransients ();
+	void allocateTransients ();
+	void report () const;
+	void dropFramebuffers (const std::string & name);
+
+	GLsizei m_width = 0;
+	GLsizei m_height = 0;
+	std::map<std::string, Slot> m_slots;
+	std::map<std::string, Lifetime> m_lifetimes;
+	std::map<std::string, std::unique_ptr<Framebuffer>> m_framebuffers;
+	RenderTargetPool m_pool;
+};
+
+#endif // RENDER_TARGET_H
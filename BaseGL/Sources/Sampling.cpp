@@ -1,47 +1,151 @@
-#include<vector>
-#include<random>
+#include "Sampling.h"
+
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/constants.hpp>
 
 using namespace std;
-typedef std::vector<glm::vec3> vv3;
 
-default_random_engine gen;
-float lerp (float a, float b, float f) { return a + f * (b - a); }
-uniform_real_distribution<float> dist(0,1);
-const float pi = acos(-1);
+namespace Sampling {
+
+static const char * SEQUENCE_NAMES[] = { "random", "Hammersley", "Halton", "Sobol" };
+
+const char * name (Sequence sequence) {
+	return SEQUENCE_NAMES[sequence];
+}
+
+// Integer hash with a low bias (lowbias32), the source of every random number, so that they do not depend on the platform
+static uint32_t hash (uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+// Uniform float in [0, 1) from 32 random bits
+static float toUnit (uint32_t bits) {
+	return (bits >> 8) * (1.f / 16777216.f);
+}
+
+// Independent random number for a seed, an index and a dimension
+static uint32_t random (uint32_t seed, uint32_t index, uint32_t dimension) {
+	return hash (hash (hash (seed) ^ index) + dimension * 0x9e3779b9u);
+}
+
+static uint32_t reverseBits (uint32_t x) {
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+	x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+// Owen scrambling of the bits of x, from the most significant one, as a hash of the more significant bits
+// (Laine-Karras permutation of the reversed bits, see Burley 2020, Practical Hash-based Owen Scrambling)
+static uint32_t owenScramble (uint32_t x, uint32_t seed) {
+	x = reverseBits (x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverseBits (x);
+}
+
+float radicalInverse (uint32_t index, uint32_t base) {
+	if (base == 2)
+		return toUnit (reverseBits (index));
+	double inverse = 0.0, factor = 1.0 / base;
+	for (; index > 0; index /= base, factor /= base)
+		inverse += (index % base) * factor;
+	return std::min (static_cast<float> (inverse), 1.f - 1.f / 16777216.f);
+}
+
+// Direction numbers of the first three dimensions of the Sobol sequence, from the primitive polynomials
+// x (van der Corput), x + 1 and x^2 + x + 1, with the initial numbers m = 1 and m = 1, 3 (Joe and Kuo)
+struct SobolDirections {
+	uint32_t v[3][32];
+	SobolDirections () {
+		for (int k = 0; k < 32; k++)
+			v[0][k] = 1u << (31 - k);
+		v[1][0] = 1u << 31;
+		for (int k = 1; k < 32; k++)
+			v[1][k] = v[1][k - 1] ^ (v[1][k - 1] >> 1);
+		v[2][0] = 1u << 31;
+		v[2][1] = 3u << 30;
+		for (int k = 2; k < 32; k++)
+			v[2][k] = v[2][k - 1] ^ v[2][k - 2] ^ (v[2][k - 2] >> 2);
+	}
+};
 
-glm::vec3 uniHalfSphere() {
-    float z = 2*dist(gen)-1;
-    float th = 2*pi * dist(gen);
-    float r = sqrt(1-z*z);
-    return { r*cos(th), r*sin(th), abs(z) };
+float sobol (uint32_t index, int dimension, uint32_t seed) {
+	static const SobolDirections directions;
+	uint32_t x = 0;
+	for (int k = 0; index > 0; index >>= 1, k++)
+		if (index & 1)
+			x ^= directions.v[dimension][k];
+	if (seed != 0)
+		x = owenScramble (x, random (seed, 0, dimension));
+	return toUnit (x);
 }
 
-glm::vec3 uniDisk() {
-    float th = 2*pi * dist(gen);
-    float r = dist(gen);
-    r = sqrt(r);
-    return { r*cos(th), r*sin(th), 0 };
+glm::vec3 point (Sequence sequence, uint32_t index, uint32_t count, uint32_t seed) {
+	glm::vec3 u;
+	switch (sequence) {
+	case HAMMERSLEY:
+		u = glm::vec3 ((index + .5f) / count, radicalInverse (index, 2), radicalInverse (index, 3));
+		break;
+	case HALTON:
+		u = glm::vec3 (radicalInverse (index, 2), radicalInverse (index, 3), radicalInverse (index, 5));
+		break;
+	case SOBOL:
+		return glm::vec3 (sobol (index, 0, seed), sobol (index, 1, seed), sobol (index, 2, seed));
+	default:
+		return glm::vec3 (toUnit (random (seed, index, 0)), toUnit (random (seed, index, 1)), toUnit (random (seed, index, 2)));
+	}
+	if (seed != 0) { // Cranley-Patterson rotation
+		glm::vec3 shift (toUnit (random (seed, 0, 0)), toUnit (random (seed, 0, 1)), toUnit (random (seed, 0, 2)));
+		u = glm::fract (u + shift);
+	}
+	return u;
 }
 
-vv3 generateKernel(int kernelSize) {
-    vv3 kernel(kernelSize);
-    for (int i = 0; i < kernelSize; i++) {
-        auto sample = uniHalfSphere();
+glm::vec3 uniformHemisphere (const glm::vec2 & u) {
+	float phi = glm::two_pi<float> () * u.x;
+	float z = u.y;
+	float r = std::sqrt (std::max (0.f, 1.f - z * z));
+	return glm::vec3 (r * std::cos (phi), r * std::sin (phi), z);
+}
 
-        float scale = (float) i / kernelSize;
-        scale = lerp(0.1f, 1.0f, scale * scale);
+glm::vec3 cosineHemisphere (const glm::vec2 & u) {
+	float phi = glm::two_pi<float> () * u.x;
+	float r = std::sqrt (u.y); // uniform on the unit disk, projected up to the hemisphere
+	return glm::vec3 (r * std::cos (phi), r * std::sin (phi), std::sqrt (std::max (0.f, 1.f - u.y)));
+}
 
-        kernel[i] = sample * scale;
-    }
-    return kernel;
+float kernelRadius (float u) {
+	return 0.1f + 0.9f * u * u;
 }
 
+std::vector<glm::vec3> generateKernel (int size, Sequence sequence, uint32_t seed) {
+	std::vector<glm::vec3> kernel (size);
+	int bits = 0;
+	while ((1 << bits) < size)
+		bits++;
+	const bool reversed = (1 << bits) == size;
+	for (int i = 0; i < size; i++) {
+		if (sequence == RANDOM) { // radius in the order of the samples, so that interleaved subsets span all the radii
+			glm::vec3 u = point (RANDOM, i, size, seed);
+			kernel[i] = uniformHemisphere (glm::vec2 (u)) * kernelRadius (float (i) / size);
+			continue;
+		}
+		uint32_t index = reversed && bits > 0 ? reverseBits (i) >> (32 - bits) : i;
+		glm::vec3 u = point (sequence, index, size, seed);
+		kernel[i] = cosineHemisphere (glm::vec2 (u)) * kernelRadius (u.z);
+	}
+	return kernel;
+}
 
-vv3 generateNoise(int noiseSize) {
-    vv3 noise(noiseSize);
-    for (int i = 0; i < noiseSize; i++) {
-        auto sample = uniDisk();
-        noise[i] = sample;
-    }
-    return noise;
 }
@@ -0,0 +1,50 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+/// Sample sequences and the SSDO kernels built from them. Every generator is deterministic: the same seed gives
+/// the same samples on every platform. Seed 0 gives the plain low-discrepancy sequences, other seeds randomize them
+/// (Owen scrambling for Sobol, a random toroidal shift for Hammersley and Halton), so that independent kernels can be averaged.
+namespace Sampling {
+
+enum Sequence {
+	RANDOM,     ///< Independent uniform hemisphere samples, the radius increasing with the index (the original kernel)
+	HAMMERSLEY,
+	HALTON,
+	SOBOL,
+	SEQUENCES
+};
+
+const char * name (Sequence sequence);
+
+/// Radical inverse of the index in the given base: its digits mirrored around the decimal point
+float radicalInverse (uint32_t index, uint32_t base);
+
+/// Sobol sequence in dimension 0, 1 or 2, Owen scrambled by a non zero seed
+float sobol (uint32_t index, int dimension, uint32_t seed = 0);
+
+/// Point of the given sequence in [0, 1)^3. count is the number of points of a Hammersley set.
+glm::vec3 point (Sequence sequence, uint32_t index, uint32_t count, uint32_t seed = 0);
+
+/// Mappings of the unit square to the unit hemisphere around +Z, with a uniform or a cosine-weighted density
+glm::vec3 uniformHemisphere (const glm::vec2 & u);
+glm::vec3 cosineHemisphere (const glm::vec2 & u);
+
+/// Distance to the center of a kernel sample for a uniform variable, denser close to the center
+float kernelRadius (float u);
+
+/// Whether the directions of the kernels of a sequence are cosine-weighted, so that the estimators drop the cosine factor
+inline bool cosineWeighted (Sequence sequence) { return sequence != RANDOM; }
+
+/// SSDO kernel in the tangent frame, in the hemisphere around +Z. The low-discrepancy kernels take the azimuth, the
+/// cosine-weighted elevation and the stratified radius from the three dimensions of the sequence. For a power of two size,
+/// their samples are in bit-reversed order, so that every interleaved subset (k * stride + offset, for a power of two stride)
+/// holds an aligned block of consecutive points, itself well distributed.
+std::vector<glm::vec3> generateKernel (int size, Sequence sequence, uint32_t seed = 0);
+
+}
+
+#endif // SAMPLING_H
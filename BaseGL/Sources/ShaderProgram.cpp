@@ -7,6 +7,8 @@
 #include <exception>
 #include <ios>
 
+#include "Trace.h"
+
 using namespace std;
 
 // Create a GPU program i.e., a graphics pipeline
@@ -26,9 +28,11 @@ std::string ShaderProgram::file2String (const std::string & filename) {
 	return buffer.str ();
 }
 
-void ShaderProgram::loadShader (GLenum type, const std::string & shaderFilename) {
+void ShaderProgram::loadShader (GLenum type, const std::string & shaderFilename, const std::string & defines) {
 	GLuint shader = glCreateShader (type); // Create the shader, e.g., a vertex shader to be applied to every single vertex of a mesh
 	std::string shaderSourceString = file2String (shaderFilename); // Loads the shader source from a file to a C++ string
+	if (!defines.empty ()) // #line keeps the line numbers of the compiler messages those of the file
+		shaderSourceString.insert (shaderSourceString.find ('\n') + 1, defines + "\n#line 2\n");
 	const GLchar * shaderSource = (const GLchar *)shaderSourceString.c_str (); // Interface the C++ string through a C pointer
 	glShaderSource (shader, 1, &shaderSource, NULL); // Load the vertex shader source code
 	glCompileShader (shader);  // THe GPU driver compile the shader
@@ -37,10 +41,20 @@ void ShaderProgram::loadShader (GLenum type, const std::string & shaderFilename)
 }
 
 std::shared_ptr<ShaderProgram> ShaderProgram::genBasicShaderProgram (const std::string & vertexShaderFilename,
-															 	 	 const std::string & fragmentShaderFilename) {
+															 	 	 const std::string & fragmentShaderFilename,
+															 	 	 const std::string & defines) {
+	Trace::Scope scope (fragmentShaderFilename); // compile and link
+	std::shared_ptr<ShaderProgram> shaderProgramPtr = std::make_shared<ShaderProgram> ();
+	shaderProgramPtr->loadShader (GL_VERTEX_SHADER, vertexShaderFilename, defines);
+	shaderProgramPtr->loadShader (GL_FRAGMENT_SHADER, fragmentShaderFilename, defines);
+	shaderProgramPtr->link ();
+	return shaderProgramPtr;
+}
+
+std::shared_ptr<ShaderProgram> ShaderProgram::genComputeShaderProgram (const std::string & computeShaderFilename) {
+	Trace::Scope scope (computeShaderFilename); // compile and link
 	std::shared_ptr<ShaderProgram> shaderProgramPtr = std::make_shared<ShaderProgram> ();
-	shaderProgramPtr->loadShader (GL_VERTEX_SHADER, vertexShaderFilename);
-	shaderProgramPtr->loadShader (GL_FRAGMENT_SHADER, fragmentShaderFilename);
+	shaderProgramPtr->loadShader (GL_COMPUTE_SHADER, computeShaderFilename);
 	shaderProgramPtr->link ();
 	return shaderProgramPtr;
 }
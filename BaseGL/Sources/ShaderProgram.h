@@ -15,15 +15,21 @@ public:
 
 	virtual ~ShaderProgram ();
 
-	/// Generate a minimal shader program, made of one vertex shader and one fragment shader
+	/// Generate a minimal shader program, made of one vertex shader and one fragment shader.
+	/// The optional defines are added to both, e.g., to specialize them.
 	static std::shared_ptr<ShaderProgram> genBasicShaderProgram (const std::string & vertexShaderFilename,
-															 	 const std::string & fragmentShaderFilename);
+															 	 const std::string & fragmentShaderFilename,
+															 	 const std::string & defines = "");
+
+	/// Generate a compute program, made of a single compute shader
+	static std::shared_ptr<ShaderProgram> genComputeShaderProgram (const std::string & computeShaderFilename);
 
 	/// OpenGL identifier of the program
 	inline GLuint id () { return m_id; }
 
-	/// Loads and compile a shader from a text file, before attaching it to a program
-	void loadShader (GLenum type, const std::string & shaderFilename);
+	/// Loads and compile a shader from a text file, before attaching it to a program.
+	/// The defines (lines of preprocessor directives) are inserted after the #version directive.
+	void loadShader (GLenum type, const std::string & shaderFilename, const std::string & defines = "");
 
 	/// The main GPU program is ready to be handle streams of polygons
 	inline void link () { glLinkProgram (m_id); }
@@ -41,6 +47,8 @@ public:
 	inline void set (const std::string & name, float value)
     { glUniform1f (getLocation (name.c_str ()), value); }
 
+    inline void set (const std::string & name, const glm::ivec2 & value)
+    { glUniform2iv (getLocation (name.c_str ()), 1, glm::value_ptr(value)); }
     inline void set (const std::string & name, const glm::vec2 & value) 
     { glUniform2fv (getLocation (name.c_str ()), 1, glm::value_ptr(value)); }
     inline void set (const std::string & name, const glm::vec3 & value)
@@ -1,38 +1,222 @@
-#include <glad/glad.h>
+#include "Texture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <iostream>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "BlockCompression.h"
+#include "Ktx2.h"
+#include "Environment.h"
+#include "Trace.h"
+
+// Bytes of the six faces of the levels before the given one
+static size_t cubemapLevelOffset(int size, GLsizei level, bool compressed) {
+    size_t offset = 0;
+    for (GLsizei l = 0; l < level; l++) {
+        int s = std::max(1, size >> l);
+        offset += 6 * (compressed ? BlockCompression::bc1Size(s, s) : size_t(s) * s * 4);
+    }
+    return offset;
+}
+
+// Source stamps of the faces, as stored in the metadata of the cache
+static std::string cubemapStamps(const std::vector<std::string> & faces) {
+    std::string result;
+    for (int64_t stamp : Environment::sourceStamps(faces))
+        result += (result.empty() ? "" : " ") + std::to_string(stamp);
+    return result;
+}
+
+// Whether the cache holds the BC1 mip chain of the current faces
+static bool validCubemapCache(const Ktx2::Header & header, const std::string & stamps) {
+    if (header.vkFormat != Ktx2::VK_FORMAT_BC1_RGB_UNORM_BLOCK || header.faceCount != 6 || header.width != header.height
+        || header.width == 0 || header.keyValues.count("BaseGL.sources") == 0 || header.keyValues.at("BaseGL.sources") != stamps)
+        return false;
+    const int size = int(header.width);
+    GLsizei levels = 1;
+    while (size >> levels)
+        levels++;
+    if (GLsizei(header.levels.size()) != levels)
+        return false;
+    for (GLsizei l = 0; l < levels; l++)
+        if (header.levels[l].length != cubemapLevelOffset(size, l + 1, true) - cubemapLevelOffset(size, l, true))
+            return false;
+    return true;
+}
 
-// loads a cubemap texture from 6 individual texture faces
+// starts decoding a cubemap texture from 6 individual texture faces of the same size
 // order:
 // +X (right)
 // -X (left)
 // +Y (top)
 // -Y (bottom)
-// +Z (front) 
+// +Z (front)
 // -Z (back)
+// The mip levels are box filtered by the workers as well. Where BC1 is supported, they are compressed, and the result
+// is cached in a KTX2 file next to the first face, read instead of the faces as long as they do not change.
+// The unpack buffer stays mapped until finishCubemap, so OpenGL can keep working (e.g., compiling shaders) meanwhile.
 // -------------------------------------------------------
-unsigned int loadCubemap(vector<std::string> faces) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
+PendingCubemap startCubemap(ThreadPool & pool, const std::vector<std::string> & faces) {
+    PendingCubemap cubemap;
+    if (faces.size() != 6)
+        throw std::runtime_error("[Texture][startCubemap] A cube map has 6 faces");
+    cubemap.compressed = GLAD_GL_EXT_texture_compression_s3tc;
+    const std::string cache = faces[0] + ".ktx2", stamps = cubemap.compressed ? cubemapStamps(faces) : "";
+    Ktx2::Header header;
+    cubemap.cached = cubemap.compressed && Ktx2::readHeader(cache, header) && validCubemapCache(header, stamps);
     int width, height, nrComponents;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrComponents, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        } else {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+    if (cubemap.cached)
+        width = height = int(header.width);
+    else if (!stbi_info(faces[0].c_str(), &width, &height, &nrComponents) || width != height)
+        throw std::runtime_error("[Texture][startCubemap] Cannot load 6 square faces from " + faces[0]);
+    const int size = cubemap.size = width;
+    cubemap.levels = 1;
+    while (size >> cubemap.levels)
+        cubemap.levels++;
+    const GLsizei levels = cubemap.levels;
+    const bool compressed = cubemap.compressed;
+    const size_t bytes = cubemapLevelOffset(size, levels, compressed);
+    glCreateBuffers(1, &cubemap.buffer);
+    glNamedBufferStorage(cubemap.buffer, bytes, nullptr, GL_MAP_WRITE_BIT);
+    unsigned char * mapped = static_cast<unsigned char *>(glMapNamedBufferRange(cubemap.buffer, 0, bytes,
+                                                                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (cubemap.cached) {
+        cubemap.faces.push_back(pool.submit([cache, header, mapped] {
+            Trace::Scope scope("read cube map cache");
+            Ktx2::readLevels(cache, header, mapped);
+        }));
+        return cubemap;
+    }
+
+    // The blocks are also kept in memory for the cache, written by the face finishing last
+    auto blocks = compressed ? std::make_shared<std::vector<unsigned char>>(bytes) : nullptr;
+    auto remaining = std::make_shared<std::atomic<int>>(6);
+    for (int face = 0; face < 6; face++) {
+        std::string path = faces[face];
+        cubemap.faces.push_back(pool.submit([path, mapped, face, size, levels, compressed, blocks, remaining, cache, stamps] {
+            Trace::Scope scope("decode cube map face");
+            int w, h, n;
+            unsigned char * data = stbi_load(path.c_str(), &w, &h, &n, 4);
+            if (!data)
+                throw std::runtime_error("[Texture][startCubemap] Cannot load " + path);
+            if (w != size || h != size) {
+                stbi_image_free(data);
+                throw std::runtime_error("[Texture][startCubemap] " + path + " is not of the size of the other faces");
+            }
+            std::vector<unsigned char> level(data, data + size_t(size) * size * 4), next;
             stbi_image_free(data);
+            for (GLsizei l = 0; l < levels; l++) {
+                const int s = std::max(1, size >> l);
+                if (compressed) {
+                    const size_t faceBytes = BlockCompression::bc1Size(s, s);
+                    unsigned char * faceBlocks = blocks->data() + cubemapLevelOffset(size, l, true) + face * faceBytes;
+                    BlockCompression::encodeBC1(level.data(), s, s, faceBlocks);
+                    std::memcpy(mapped + (faceBlocks - blocks->data()), faceBlocks, faceBytes);
+                } else
+                    std::memcpy(mapped + cubemapLevelOffset(size, l, false) + size_t(face) * s * s * 4, level.data(), level.size());
+                if (l + 1 == levels)
+                    break;
+                const int half = std::max(1, s / 2);
+                next.resize(size_t(half) * half * 4);
+                for (int y = 0; y < half; y++)
+                    for (int x = 0; x < half; x++)
+                        for (int c = 0; c < 4; c++) {
+                            int x1 = std::min(2 * x + 1, s - 1), y1 = std::min(2 * y + 1, s - 1);
+                            int sum = level[(2 * y * s + 2 * x) * 4 + c] + level[(2 * y * s + x1) * 4 + c]
+                                    + level[(y1 * s + 2 * x) * 4 + c] + level[(y1 * s + x1) * 4 + c];
+                            next[(y * half + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                        }
+                level.swap(next);
+            }
+            if (compressed && --*remaining == 0) {
+                std::vector<uint64_t> lengths;
+                for (GLsizei l = 0; l < levels; l++)
+                    lengths.push_back(cubemapLevelOffset(size, l + 1, true) - cubemapLevelOffset(size, l, true));
+                try {
+                    Ktx2::writeBC1Cubemap(cache, uint32_t(size), lengths, { { "BaseGL.sources", stamps }, { "KTXwriter", "BaseGL" } },
+                                          blocks->data());
+                } catch (const std::exception & e) { // the texture is still fine
+                    std::cout << " > " << e.what() << std::endl;
+                }
+            }
+        }));
+    }
+    return cubemap;
+}
+
+bool cubemapReady(const PendingCubemap & cubemap) {
+    for (const auto & face : cubemap.faces)
+        if (face.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+    return true;
+}
+
+size_t cubemapBytes(const PendingCubemap & cubemap) {
+    return cubemapLevelOffset(cubemap.size, cubemap.levels, cubemap.compressed);
+}
+
+// Waits for the faces, and uploads them from the unpack buffer to an immutable cube map with its full mip chain
+unsigned int finishCubemap(PendingCubemap & cubemap) {
+    Trace::Scope scope("upload cube map");
+    std::exception_ptr error;
+    for (auto & face : cubemap.faces) { // every worker is done with the mapping before it is released
+        try {
+            face.get();
+        } catch (...) {
+            error = std::current_exception();
         }
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glUnmapNamedBuffer(cubemap.buffer);
+    if (error) {
+        glDeleteBuffers(1, &cubemap.buffer);
+        std::rethrow_exception(error);
+    }
 
+    unsigned int textureID;
+    glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &textureID);
+    glTextureStorage2D(textureID, cubemap.levels, cubemap.compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8,
+                       cubemap.size, cubemap.size);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, cubemap.buffer);
+    for (GLsizei level = 0; level < cubemap.levels; level++) { // the faces are the layers
+        GLsizei size = std::max(1, cubemap.size >> level);
+        size_t offset = cubemapLevelOffset(cubemap.size, level, cubemap.compressed);
+        if (cubemap.compressed)
+            glCompressedTextureSubImage3D(textureID, level, 0, 0, 0, size, size, 6, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                                          GLsizei(cubemapLevelOffset(cubemap.size, level + 1, true) - offset),
+                                          reinterpret_cast<const void *>(offset));
+        else
+            glTextureSubImage3D(textureID, level, 0, 0, 0, size, size, 6, GL_RGBA, GL_UNSIGNED_BYTE,
+                                reinterpret_cast<const void *>(offset));
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &cubemap.buffer); // released once the copies are done
+    glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(textureID, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    std::cout << " > Cube map " << cubemap.size << "x" << cubemap.size << ", " << cubemap.levels << " levels, "
+              << (cubemap.compressed ? (cubemap.cached ? "BC1 read from the cache" : "compressed to BC1") : "RGBA") << std::endl;
+    cubemap.faces.clear();
+    cubemap.buffer = 0;
     return textureID;
 }
+
+void cancelCubemap(PendingCubemap & cubemap) {
+    for (auto & face : cubemap.faces)
+        face.wait();
+    if (cubemap.buffer) {
+        glUnmapNamedBuffer(cubemap.buffer);
+        glDeleteBuffers(1, &cubemap.buffer);
+    }
+    cubemap.faces.clear();
+    cubemap.buffer = 0;
+}
+
+unsigned int loadCubemap(ThreadPool & pool, const std::vector<std::string> & faces) {
+    PendingCubemap cubemap = startCubemap(pool, faces);
+    return finishCubemap(cubemap);
+}
@@ -0,0 +1,40 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <future>
+
+#include "ThreadPool.h"
+
+// Cube map whose faces are being decoded and mipmapped on worker threads, or read from the compressed cache,
+// straight into a mapped pixel unpack buffer holding the six faces of level 0, then the six faces of level 1, and so on
+struct PendingCubemap {
+    GLuint buffer = 0;
+    int size = 0;
+    GLsizei levels = 0;
+    bool compressed = false; // BC1 blocks rather than RGBA texels
+    bool cached = false;
+    std::vector<std::future<void>> faces;
+};
+
+// Starts loading a cube map from its 6 faces, in the +X, -X, +Y, -Y, +Z, -Z order. A valid OpenGL context must be active.
+PendingCubemap startCubemap(ThreadPool & pool, const std::vector<std::string> & faces);
+
+// Whether the workers are done with the cube map, so that finishCubemap does not wait
+bool cubemapReady(const PendingCubemap & cubemap);
+
+// GPU memory of the cube map once finished
+size_t cubemapBytes(const PendingCubemap & cubemap);
+
+// Waits for the workers, and uploads the cube map
+unsigned int finishCubemap(PendingCubemap & cubemap);
+
+// Waits for the workers, and releases the cube map without uploading it
+void cancelCubemap(PendingCubemap & cubemap);
+
+// Loads a cube map from its 6 faces, in the order of startCubemap
+unsigned int loadCubemap(ThreadPool & pool, const std::vector<std::string> & faces);
+
+#endif // TEXTURE_H
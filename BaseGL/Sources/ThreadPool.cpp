@@ -0,0 +1,50 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+ThreadPool::ThreadPool (unsigned int threadCount) {
+	if (threadCount == 0)
+		threadCount = std::max (1u, std::thread::hardware_concurrency ());
+	for (unsigned int i = 0; i < threadCount; i++)
+		m_workers.emplace_back (&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool () {
+	{
+		std::lock_guard<std::mutex> lock (m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all ();
+	for (auto & worker : m_workers)
+		worker.join ();
+}
+
+void ThreadPool::work () {
+	for (;;) {
+		std::function<void ()> task;
+		{
+			std::unique_lock<std::mutex> lock (m_mutex);
+			m_condition.wait (lock, [this] { return m_stopping || !m_tasks.empty (); });
+			if (m_tasks.empty ())
+				return; // stopping, and nothing left to run
+			task = std::move (m_tasks.front ());
+			m_tasks.pop ();
+		}
+		task ();
+	}
+}
+
+bool ThreadPool::runQueued () {
+	std::function<void ()> task;
+	{
+		std::lock_guard<std::mutex> lock (m_mutex);
+		if (m_tasks.empty ())
+			return false;
+		task = std::move (m_tasks.front ());
+		m_tasks.pop ();
+	}
+	task ();
+	return true;
+}
@@ -0,0 +1,61 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <chrono>
+
+/// Fixed set of worker threads running submitted tasks in submission order. Tasks must not use OpenGL.
+class ThreadPool {
+public:
+	/// Starts the given number of workers, or one per hardware thread if 0
+	explicit ThreadPool (unsigned int threadCount = 0);
+
+	/// Waits for the queued tasks, then joins the workers
+	virtual ~ThreadPool ();
+
+	ThreadPool (const ThreadPool &) = delete;
+	ThreadPool & operator= (const ThreadPool &) = delete;
+
+	inline size_t size () const { return m_workers.size (); }
+
+	/// Queues a task. Its result, or the exception it throws, is delivered through the future.
+	template <class F>
+	auto submit (F task) -> std::future<decltype (task ())> {
+		auto packaged = std::make_shared<std::packaged_task<decltype (task ()) ()>> (std::move (task));
+		std::future<decltype (task ())> result = packaged->get_future ();
+		{
+			std::lock_guard<std::mutex> lock (m_mutex);
+			m_tasks.push ([packaged] { (*packaged) (); });
+		}
+		m_condition.notify_one ();
+		return result;
+	}
+
+	/// Waits for the result of a task, running the queued tasks meanwhile, so that a task may wait for the tasks
+	/// it submitted without holding up a worker they need
+	template <class T>
+	void wait (const std::future<T> & result) {
+		while (result.wait_for (std::chrono::seconds (0)) != std::future_status::ready)
+			if (!runQueued ())
+				result.wait (); // the task runs on another worker
+	}
+
+private:
+	void work ();
+	bool runQueued (); // runs the next queued task on the calling thread, false if there is none
+
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void ()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stopping = false;
+};
+
+#endif // THREAD_POOL_H
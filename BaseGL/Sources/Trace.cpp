@@ -0,0 +1,163 @@
+#include "Trace.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+
+using namespace std;
+
+namespace Trace {
+
+std::atomic<bool> recording (false);
+
+struct CpuSpan {
+	std::string name;
+	double start, end; // microseconds since the start of the trace
+	std::thread::id thread;
+};
+
+struct GpuSpan {
+	std::string name;
+	GLuint queries[2]; // timestamps of the beginning and the end
+	size_t frame;
+};
+
+// GPU clock at a given time of the CPU clock, taken at the first GPU span of each frame
+struct Calibration {
+	double cpu; // microseconds since the start of the trace
+	GLint64 gpu; // nanoseconds
+};
+
+static std::mutex s_mutex; // guards the CPU spans, recorded by any thread
+static std::vector<CpuSpan> s_cpuSpans;
+static std::vector<GpuSpan> s_gpuSpans;
+static std::vector<size_t> s_openGpuSpans;
+static std::vector<Calibration> s_calibrations;
+static std::chrono::steady_clock::time_point s_origin;
+static std::thread::id s_mainThread;
+static std::string s_filename;
+static size_t s_frame = 0;
+static int s_frames = 0;
+
+double Scope::now () {
+	return std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now () - s_origin).count ();
+}
+
+void Scope::cpuSpan (const std::string & name, double start, double end) {
+	std::lock_guard<std::mutex> lock (s_mutex);
+	if (enabled ()) // unless the trace was written in the meantime
+		s_cpuSpans.push_back ({ name, start, end, std::this_thread::get_id () });
+}
+
+void start (const std::string & filename, int frames) {
+	if (enabled () || frames <= 0)
+		return;
+	std::lock_guard<std::mutex> lock (s_mutex);
+	s_cpuSpans.clear ();
+	s_gpuSpans.clear ();
+	s_openGpuSpans.clear ();
+	s_calibrations.clear ();
+	s_origin = std::chrono::steady_clock::now ();
+	s_mainThread = std::this_thread::get_id ();
+	s_filename = filename;
+	s_frame = 0;
+	s_frames = frames;
+	recording.store (true, std::memory_order_release);
+}
+
+void beginGpuSpan (const std::string & name) {
+	if (s_calibrations.size () <= s_frame) {
+		Calibration calibration;
+		glGetInteger64v (GL_TIMESTAMP, &calibration.gpu); // now, not once the previous commands are done
+		calibration.cpu = Scope::now ();
+		s_calibrations.resize (s_frame + 1, calibration);
+	}
+	GpuSpan span = { name, { 0, 0 }, s_frame };
+	glCreateQueries (GL_TIMESTAMP, 2, span.queries);
+	glQueryCounter (span.queries[0], GL_TIMESTAMP);
+	glPushDebugGroup (GL_DEBUG_SOURCE_APPLICATION, 0, -1, name.c_str ());
+	s_openGpuSpans.push_back (s_gpuSpans.size ());
+	s_gpuSpans.push_back (span);
+}
+
+void endGpuSpan () {
+	if (s_openGpuSpans.empty ())
+		return; // began before the recording
+	glPopDebugGroup ();
+	glQueryCounter (s_gpuSpans[s_openGpuSpans.back ()].queries[1], GL_TIMESTAMP);
+	s_openGpuSpans.pop_back ();
+}
+
+// Name as a JSON string
+static std::string quoted (const std::string & name) {
+	std::string result = "\"";
+	for (char c : name) {
+		if (c == '"' || c == '\\')
+			result += '\\';
+		result += c;
+	}
+	return result + "\"";
+}
+
+static void write () {
+	std::vector<CpuSpan> cpuSpans;
+	{
+		std::lock_guard<std::mutex> lock (s_mutex);
+		recording.store (false, std::memory_order_release);
+		cpuSpans.swap (s_cpuSpans);
+	}
+	ofstream out (s_filename.c_str ());
+	if (!out)
+		std::cout << " > Cannot write the trace " << s_filename << std::endl;
+	out << std::fixed << std::setprecision (3);
+	// Thread 0 is the GPU, 1 the main thread, the others numbered in the order of their first span
+	std::vector<std::thread::id> threads = { s_mainThread };
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+	for (const auto & span : cpuSpans) {
+		size_t thread = std::find (threads.begin (), threads.end (), span.thread) - threads.begin ();
+		if (thread == threads.size ())
+			threads.push_back (span.thread);
+		out << "," << std::endl << "{\"name\":" << quoted (span.name) << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread + 1
+			<< ",\"ts\":" << span.start << ",\"dur\":" << span.end - span.start << "}";
+	}
+	for (size_t thread = 0; thread < threads.size (); thread++)
+		out << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread + 1 << ",\"args\":{\"name\":"
+			<< (thread == 0 ? "\"main\"" : quoted ("worker " + std::to_string (thread))) << "}}";
+	// Reading the results waits for the GPU, once
+	for (const auto & span : s_gpuSpans) {
+		GLuint64 times[2];
+		glGetQueryObjectui64v (span.queries[0], GL_QUERY_RESULT, &times[0]);
+		glGetQueryObjectui64v (span.queries[1], GL_QUERY_RESULT, &times[1]);
+		glDeleteQueries (2, span.queries);
+		const Calibration & calibration = s_calibrations[span.frame];
+		double start = calibration.cpu + (static_cast<GLint64> (times[0]) - calibration.gpu) * 1e-3;
+		out << "," << std::endl << "{\"name\":" << quoted (span.name) << ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":0"
+			<< ",\"ts\":" << start << ",\"dur\":" << (times[1] - times[0]) * 1e-3 << "}";
+	}
+	out << std::endl << "]}" << std::endl;
+	if (out)
+		std::cout << " > Trace of " << s_frame << " frames written to " << s_filename << " (" << cpuSpans.size ()
+				  << " CPU spans, " << s_gpuSpans.size () << " GPU spans)" << std::endl;
+	s_gpuSpans.clear ();
+	s_calibrations.clear ();
+}
+
+void endFrame () {
+	if (!enabled ())
+		return;
+	if (++s_frame == static_cast<size_t> (s_frames))
+		write ();
+}
+
+void stop () {
+	if (enabled ())
+		write ();
+}
+
+}
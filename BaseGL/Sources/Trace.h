@@ -0,0 +1,78 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <glad/glad.h>
+#include <string>
+#include <atomic>
+
+/// Timeline of the CPU and GPU work of a few frames, written as Chrome trace events (chrome://tracing, or ui.perfetto.dev).
+/// CPU spans are scopes of any thread; GPU spans are delimited by timestamp queries, and labelled with debug groups for
+/// the graphics debuggers. The GPU times are converted to the CPU clock, so that both share the same timeline.
+/// While no trace is being recorded, a span only costs the test of an atomic flag.
+namespace Trace {
+
+/// Set by start and cleared once the trace is written. Read it through enabled ().
+extern std::atomic<bool> recording;
+
+inline bool enabled () { return recording.load (std::memory_order_acquire); }
+
+/// Starts recording, up to the end of the given number of frames. The calling thread becomes the "main" thread of the trace,
+/// which issues the OpenGL commands: recording may start before the context is created, e.g., to trace the initialization.
+void start (const std::string & filename, int frames);
+
+/// End of a frame, on the main thread. The trace is written at the end of the last one: the GPU spans are read back then.
+void endFrame ();
+
+/// Writes the trace recorded so far, if any, when the program ends before its last frame. Requires the OpenGL context.
+void stop ();
+
+/// Span on the calling thread, from its construction to its destruction. The name is only copied while recording.
+class Scope {
+public:
+	explicit Scope (const char * name) : m_active (enabled ()) {
+		if (m_active) {
+			m_name = name;
+			m_start = now ();
+		}
+	}
+	explicit Scope (const std::string & name) : m_active (enabled ()) {
+		if (m_active) {
+			m_name = name;
+			m_start = now ();
+		}
+	}
+	~Scope () {
+		if (m_active)
+			cpuSpan (m_name, m_start, now ());
+	}
+
+	Scope (const Scope &) = delete;
+	Scope & operator= (const Scope &) = delete;
+
+	/// Microseconds since the start of the trace
+	static double now ();
+
+private:
+	static void cpuSpan (const std::string & name, double start, double end);
+
+	bool m_active;
+	std::string m_name;
+	double m_start = 0.0;
+};
+
+void beginGpuSpan (const std::string & name);
+void endGpuSpan ();
+
+/// GPU span of the commands issued in between, on the main thread. GPU spans nest.
+inline void beginGpu (const std::string & name) {
+	if (enabled ())
+		beginGpuSpan (name);
+}
+inline void endGpu () {
+	if (enabled ())
+		endGpuSpan ();
+}
+
+}
+
+#endif // TRACE_H
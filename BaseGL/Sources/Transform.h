@@ -11,11 +11,14 @@ public:
 	virtual ~Transform () {}
 
 	inline const glm::vec3 getTranslation () const { return m_translation; }
-	inline void setTranslation (const glm::vec3 & t) { m_translation = t; }
+	inline void setTranslation (const glm::vec3 & t) { m_translation = t; touch (); }
 	inline const glm::vec3 getRotation () const { return m_rotation; }
-	inline void setRotation (const glm::vec3 & r) { m_rotation = r; }
+	inline void setRotation (const glm::vec3 & r) { m_rotation = r; touch (); }
 	inline float getScale () const { return m_scale; }
-	inline void setScale (float s) { m_scale = s; }
+	inline void setScale (float s) { m_scale = s; touch (); }
+
+	/// Incremented by every change, so that one can tell whether the entity changed since it was last rendered
+	inline unsigned int revision () const { return m_revision; }
 
 	inline glm::mat4 computeTransformMatrix () const {
 		glm::mat4 id (1.0);
@@ -27,10 +30,14 @@ public:
 		return trsm;
 	}
 
+protected:
+	inline void touch () { m_revision++; }
+
 private:
 	glm::vec3 m_translation;
 	glm::vec3 m_rotation;
 	float m_scale;
+	unsigned int m_revision = 0;
 };
 
 #endif // TRANSFORM_H
\ No newline at end of file